@@ -26,6 +26,13 @@
 #include "MongoUtil.h"
 
 #endif /* USE_MONGODB */
+/// include block compression libraries of GridFS payloads, optional
+#ifdef USE_LZ4
+#include "lz4.h"
+#endif /* USE_LZ4 */
+#ifdef USE_ZSTD
+#include "zstd.h"
+#endif /* USE_ZSTD */
 /// include utility functions
 #include "utilities.h"
 /// include GDAL, required
@@ -39,13 +46,41 @@
 #include <omp.h>
 
 #endif /* SUPPORT_OMP */
+/// bit scan intrinsics of MSVC
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif /* _MSC_VER */
+/// aligned allocation
+#if defined(_WIN32)
+#include <malloc.h>
+#endif /* _WIN32 */
 /// include base headers
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #include <string>
 #include <map>
+#include <set>
 #include <fstream>
 #include <iomanip>
 #include <typeinfo>
+#include <type_traits>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+/// include C++11 concurrency headers for the asynchronous output
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <random>
+#include <atomic>
 
 using namespace std;
 
@@ -56,79 +91,2372 @@ using namespace std;
 #pragma warning(disable: 4100 4190 4251 4275 4305 4309 4819 4996)
 #endif /* Ignore warnings of GDAL */
 
+/* noexcept is not supported until MSVC 2015 */
+#ifndef NOEXCEPT
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#define NOEXCEPT throw()
+#else
+#define NOEXCEPT noexcept
+#endif
+#endif /* NOEXCEPT */
+
+/*!
+ * Define Raster related constant strings used for raster headers
+ */
+#define HEADER_RS_NODATA        "NODATA_VALUE"
+#define HEADER_RS_XLL           "XLLCENTER"  /// or XLLCORNER
+#define HEADER_RS_YLL           "YLLCENTER"  /// or YLLCORNER
+#define HEADER_RS_NROWS         "NROWS"
+#define HEADER_RS_NCOLS         "NCOLS"
+#define HEADER_RS_CELLSIZE      "CELLSIZE"
+#define HEADER_RS_LAYERS        "LAYERS"
+#define HEADER_RS_CELLSNUM      "CELLSNUM"
+#define HEADER_RS_SRS           "SRS"
+#define HEADER_RS_DATATYPE      "DATATYPE"
+#define HEADER_RS_LAYOUT        "LAYOUT"
+#define HEADER_RS_RUNSNUM       "RUNSNUM"
+#define HEADER_RS_COMPRESSION   "COMPRESSION"
+#define HEADER_RS_BLOCKSIZE     "BLOCKSIZE"
+#define HEADER_RS_RAWLENGTH     "RAWLENGTH"
+
+/*!
+ * Define constant strings of statistics index
+ */
+#define STATS_RS_VALIDNUM        "VALID_CELLNUMBER"
+#define STATS_RS_MEAN            "MEAN"
+#define STATS_RS_MIN             "MIN"
+#define STATS_RS_MAX             "MAX"
+#define STATS_RS_STD             "STD"
+#define STATS_RS_RANGE           "RANGE"
+
+/*!
+ * Files or database constant strings
+ */
+#define ASCIIExtension          "asc"
+#define GTiffExtension          "tif"
+#define RasterStateMagic        "RSSTATE"  /// 8 bytes with the terminating null character
+#define RasterStateVersion      2
+#define GridFSLayoutCompact     "COMPACT"  /// valid cells and run-length positions
+#define GridFSLayoutBand        "BAND"     /// full-sized, layer-major, i.e., band interleaved
+#define GridFSBlockSize         1048576    /// default uncompressed size of compression blocks
+#define GridFSStreamBufferSize  261120     /// 255 KB, i.e., the default chunk size of GridFS
+#define GridFSCacheMagic        "RSCACHE"  /// 8 bytes with the terminating null character
+#define GridFSCacheExtension    "rsc"
+
+/*!
+ * Memory alignment (bytes) of raster data buffers, i.e., one cache line and one AVX-512 register
+ */
+#define RasterDataAlignment     64
+
+typedef pair<int, int> RowCol;
+typedef pair<double, double> XYCoor;
+
+/*!
+ * \enum RasterDataType
+ * \brief Data type of raster values stored in external storage, e.g., GridFS.
+ */
+enum RasterDataType {
+    RDT_Unknown,  ///< Unknown or unsupported
+    RDT_UInt8,    ///< 8-bit unsigned integer
+    RDT_Int8,     ///< 8-bit signed integer
+    RDT_UInt16,   ///< 16-bit unsigned integer
+    RDT_Int16,    ///< 16-bit signed integer
+    RDT_UInt32,   ///< 32-bit unsigned integer
+    RDT_Int32,    ///< 32-bit signed integer
+    RDT_UInt64,   ///< 64-bit unsigned integer
+    RDT_Int64,    ///< 64-bit signed integer
+    RDT_Float,    ///< 32-bit floating point
+    RDT_Double    ///< 64-bit floating point
+};
+
+/*!
+ * \enum RasterCompression
+ * \brief Block compression of raster payloads stored in external storage, e.g., GridFS.
+ */
+enum RasterCompression {
+    RCP_None,  ///< Uncompressed
+    RCP_LZ4,   ///< LZ4, fast decompression
+    RCP_Zstd   ///< Zstandard, higher ratio
+};
+
+/*!
+ * \enum RasterLayout
+ * \brief Memory layout of multi-layer (2D) raster data.
+ */
+enum RasterLayout {
+    RL_CellMajor,  ///< [cellIndex][layer], values of one cell are contiguous
+    RL_LayerMajor  ///< [layer][cellIndex], each layer is one contiguous plane
+};
+
+/** Common functions independent to clsRasterData **/
+inline void print_status(string status_str) {
+#ifndef UNITTEST
+    cout << status_str << endl;
+#endif
+}
+
+/*!
+ * \brief check the existence of given raster file
+ */
+inline bool _check_raster_files_exist(const string &filename) {
+    if (!FileExists(filename)) {
+        print_status("The raster file " + filename + " does not exist or has not read permission.");
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief check the existence of given vector of raster files
+ * \return True if all existed, else false
+ */
+inline bool _check_raster_files_exist(vector<string> &filenames) {
+    for (auto it = filenames.begin(); it != filenames.end(); it++) {
+        if (!_check_raster_files_exist(*it)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T1, typename T2>
+inline void _get_data_from_gdal(T1 *dst, T2 *src, int nr, int nc) {
+#pragma omp parallel for
+    for (int i = 0; i < nr; ++i) {
+        for (int j = 0; j < nc; ++j) {
+            int index = i * nc + j;
+            dst[index] = (T1) src[index];
+        }
+    }
+}
+
+/*!
+ * \brief Build the next overview level by averaging each 2 x 2 block of the source level.
+ *        NoDATA cells are excluded, and the block is NoDATA only if all its cells are NoDATA.
+ * \param[in] src Source level data, with the size of srcRows * srcCols
+ * \param[in] srcRows Row number of source level
+ * \param[in] srcCols Column number of source level
+ * \param[in] nodata NoDATA value
+ * \param[out] dst Allocated array, with the size of ceil(srcRows / 2) * ceil(srcCols / 2)
+ */
+inline void _build_overview_by_average(const float *src, int srcRows, int srcCols, float nodata, float *dst) {
+    int dstRows = (srcRows + 1) / 2;
+    int dstCols = (srcCols + 1) / 2;
+#pragma omp parallel for
+    for (int i = 0; i < dstRows; ++i) {
+        for (int j = 0; j < dstCols; ++j) {
+            double sum = 0.;
+            int count = 0;
+            for (int si = 2 * i; si < 2 * i + 2 && si < srcRows; ++si) {
+                for (int sj = 2 * j; sj < 2 * j + 2 && sj < srcCols; ++sj) {
+                    float v = src[si * srcCols + sj];
+                    if (FloatEqual(v, nodata)) continue;
+                    sum += v;
+                    count++;
+                }
+            }
+            dst[i * dstCols + j] = count > 0 ? (float) (sum / count) : nodata;
+        }
+    }
+}
+
+/*!
+ * \brief Get the RasterDataType of the given C++ type
+ */
+template<typename T>
+inline RasterDataType _get_raster_data_type() {
+    if (std::is_floating_point<T>::value) {
+        return sizeof(T) == 4 ? RDT_Float : sizeof(T) == 8 ? RDT_Double : RDT_Unknown;
+    }
+    if (!std::is_integral<T>::value || std::is_same<T, bool>::value) return RDT_Unknown;
+    bool issigned = std::is_signed<T>::value;
+    switch (sizeof(T)) {
+        case 1: return issigned ? RDT_Int8 : RDT_UInt8;
+        case 2: return issigned ? RDT_Int16 : RDT_UInt16;
+        case 4: return issigned ? RDT_Int32 : RDT_UInt32;
+        case 8: return issigned ? RDT_Int64 : RDT_UInt64;
+        default: return RDT_Unknown;
+    }
+}
+
+/*!
+ * \brief Get the size in bytes of RasterDataType, 0 for RDT_Unknown
+ */
+inline int _get_raster_data_type_size(RasterDataType type) {
+    switch (type) {
+        case RDT_UInt8: case RDT_Int8: return 1;
+        case RDT_UInt16: case RDT_Int16: return 2;
+        case RDT_UInt32: case RDT_Int32: case RDT_Float: return 4;
+        case RDT_UInt64: case RDT_Int64: case RDT_Double: return 8;
+        default: return 0;
+    }
+}
+
+/*!
+ * \brief Convert RasterDataType to string, e.g., "FLOAT32", which is stored in metadata
+ */
+inline string RasterDataTypeToString(RasterDataType type) {
+    switch (type) {
+        case RDT_UInt8: return "UINT8";
+        case RDT_Int8: return "INT8";
+        case RDT_UInt16: return "UINT16";
+        case RDT_Int16: return "INT16";
+        case RDT_UInt32: return "UINT32";
+        case RDT_Int32: return "INT32";
+        case RDT_UInt64: return "UINT64";
+        case RDT_Int64: return "INT64";
+        case RDT_Float: return "FLOAT32";
+        case RDT_Double: return "FLOAT64";
+        default: return "UNKNOWN";
+    }
+}
+
+/*!
+ * \brief Convert string to RasterDataType, case insensitive, \sa RasterDataTypeToString
+ */
+inline RasterDataType StringToRasterDataType(const string &str) {
+    RasterDataType types[10] = {RDT_UInt8, RDT_Int8, RDT_UInt16, RDT_Int16, RDT_UInt32,
+                                RDT_Int32, RDT_UInt64, RDT_Int64, RDT_Float, RDT_Double};
+    for (int i = 0; i < 10; i++) {
+        if (StringMatch(str, RasterDataTypeToString(types[i]))) return types[i];
+    }
+    return RDT_Unknown;
+}
+
+/*!
+ * \brief Cast array of type TS to array of type TD
+ */
+template<typename TS, typename TD>
+inline void _cast_array(const TS *src, int n, TD *dst) {
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        dst[i] = (TD) src[i];
+    }
+}
+
+/*!
+ * \brief Convert raw data stored as RasterDataType to array of type TD
+ * \param[in] src Raw data
+ * \param[in] type Data type of \a src
+ * \param[in] n Element number
+ * \param[out] dst Allocated array with the length of \a n
+ * \return false if \a type is RDT_Unknown
+ */
+template<typename TD>
+inline bool _convert_raster_data(const char *src, RasterDataType type, int n, TD *dst) {
+    switch (type) {
+        case RDT_UInt8: _cast_array((const uint8_t *) src, n, dst); break;
+        case RDT_Int8: _cast_array((const int8_t *) src, n, dst); break;
+        case RDT_UInt16: _cast_array((const uint16_t *) src, n, dst); break;
+        case RDT_Int16: _cast_array((const int16_t *) src, n, dst); break;
+        case RDT_UInt32: _cast_array((const uint32_t *) src, n, dst); break;
+        case RDT_Int32: _cast_array((const int32_t *) src, n, dst); break;
+        case RDT_UInt64: _cast_array((const uint64_t *) src, n, dst); break;
+        case RDT_Int64: _cast_array((const int64_t *) src, n, dst); break;
+        case RDT_Float: _cast_array((const float *) src, n, dst); break;
+        case RDT_Double: _cast_array((const double *) src, n, dst); break;
+        default: return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief Convert array of type TS to raw data stored as RasterDataType, \sa _convert_raster_data
+ * \param[in] src Array of type TS
+ * \param[in] n Element number
+ * \param[in] type Data type of \a dst
+ * \param[out] dst Allocated raw data with the length of \a n elements of \a type
+ * \return false if \a type is RDT_Unknown
+ */
+template<typename TS>
+inline bool _convert_to_raster_data(const TS *src, int n, RasterDataType type, char *dst) {
+    switch (type) {
+        case RDT_UInt8: _cast_array(src, n, (uint8_t *) dst); break;
+        case RDT_Int8: _cast_array(src, n, (int8_t *) dst); break;
+        case RDT_UInt16: _cast_array(src, n, (uint16_t *) dst); break;
+        case RDT_Int16: _cast_array(src, n, (int16_t *) dst); break;
+        case RDT_UInt32: _cast_array(src, n, (uint32_t *) dst); break;
+        case RDT_Int32: _cast_array(src, n, (int32_t *) dst); break;
+        case RDT_UInt64: _cast_array(src, n, (uint64_t *) dst); break;
+        case RDT_Int64: _cast_array(src, n, (int64_t *) dst); break;
+        case RDT_Float: _cast_array(src, n, (float *) dst); break;
+        case RDT_Double: _cast_array(src, n, (double *) dst); break;
+        default: return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief Allocate \a n elements aligned at RasterDataAlignment bytes, which MUST be released by
+ *        _release_aligned_buffer. Throw bad_alloc if failed, the same as new[].
+ */
+template<typename T>
+inline T *_allocate_aligned_buffer(size_t n) {
+    size_t bytes = n > 0 ? n * sizeof(T) : 1;
+    void *buf = nullptr;
+#if defined(_WIN32)
+    buf = _aligned_malloc(bytes, RasterDataAlignment);
+#else
+    if (posix_memalign(&buf, RasterDataAlignment, bytes) != 0) buf = nullptr;
+#endif
+    if (nullptr == buf) throw bad_alloc();
+    return (T *) buf;
+}
+
+//! Release buffer allocated by _allocate_aligned_buffer
+template<typename T>
+inline void _release_aligned_buffer(T *&data) {
+    if (nullptr == data) return;
+#if defined(_WIN32)
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+    data = nullptr;
+}
+
+/*!
+ * \brief Padded length of \a n elements, i.e., rounded up to a multiple of RasterDataAlignment bytes,
+ *        or \a n itself if the element size does not divide RasterDataAlignment
+ */
+template<typename T>
+inline int _aligned_length(int n) {
+    int per = RasterDataAlignment % sizeof(T) == 0 ? (int) (RasterDataAlignment / sizeof(T)) : 1;
+    return (n + per - 1) / per * per;
+}
+
+/*!
+ * \brief Allocate 1D array aligned at RasterDataAlignment bytes, which MUST be released by
+ *        _release_aligned_buffer
+ * \param[in] n Element number
+ * \param[out] data 1D array
+ * \param[in] init Initial value
+ */
+template<typename T, typename I>
+inline void _initialize_1d_buffer(int n, T *&data, I init) {
+    data = _allocate_aligned_buffer<T>((size_t) (n > 0 ? n : 0));
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        data[i] = (T) init;
+    }
+}
+
+//! Allocate aligned 1D array and copy the values of \a init, \sa _initialize_1d_buffer
+template<typename T, typename I>
+inline void _initialize_1d_buffer(int n, T *&data, const I *init) {
+    data = _allocate_aligned_buffer<T>((size_t) (n > 0 ? n : 0));
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        data[i] = (T) init[i];
+    }
+}
+
+template<typename T, typename I>
+inline void _initialize_1d_buffer(int n, T *&data, I *init) {
+    _initialize_1d_buffer(n, data, (const I *) init);
+}
+
+/*!
+ * \brief Allocate 2D array as one contiguous buffer aligned at RasterDataAlignment bytes and the row
+ *        pointers, i.e., data[i] = data[0] + i * stride. It MUST be released by _release_2d_buffer.
+ * \param[in] row Row number, e.g., cell number
+ * \param[in] col Column number, e.g., layer number
+ * \param[out] data 2D array
+ * \param[in] init Initial value, also of the padding elements
+ * \param[in] stride Elements between consecutive rows, 0 (default) or less than \a col means \a col
+ */
+template<typename T, typename I>
+inline void _initialize_2d_buffer(int row, int col, T **&data, I init, int stride = 0) {
+    if (stride < col) stride = col;
+    T *buf = _allocate_aligned_buffer<T>((size_t) (row > 0 ? row : 0) * stride);
+    data = new T *[row > 0 ? row : 1];
+    data[0] = buf;
+#pragma omp parallel for
+    for (int i = 0; i < row; i++) {
+        data[i] = buf + (size_t) i * stride;
+        for (int j = 0; j < stride; j++) {
+            data[i][j] = (T) init;
+        }
+    }
+}
+
+/*!
+ * \brief Allocate 2D array as one contiguous aligned buffer and copy the values of \a init,
+ *        \sa _initialize_2d_buffer. The padding elements, if any, are left uninitialized.
+ */
+template<typename T, typename I>
+inline void _initialize_2d_buffer(int row, int col, T **&data, const I *const *init, int stride = 0) {
+    if (stride < col) stride = col;
+    T *buf = _allocate_aligned_buffer<T>((size_t) (row > 0 ? row : 0) * stride);
+    data = new T *[row > 0 ? row : 1];
+    data[0] = buf;
+#pragma omp parallel for
+    for (int i = 0; i < row; i++) {
+        data[i] = buf + (size_t) i * stride;
+        for (int j = 0; j < col; j++) {
+            data[i][j] = (T) init[i][j];
+        }
+    }
+}
+
+template<typename T, typename I>
+inline void _initialize_2d_buffer(int row, int col, T **&data, I **init, int stride = 0) {
+    _initialize_2d_buffer(row, col, data, (const I *const *) init, stride);
+}
+
+/*!
+ * \brief Index of the lowest set bit of a non-zero 64-bit word
+ */
+inline int _lowest_bit_index(uint64_t word) {
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long idx;
+    _BitScanForward64(&idx, word);
+    return (int) idx;
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    if (_BitScanForward(&idx, (unsigned long) word)) return (int) idx;
+    _BitScanForward(&idx, (unsigned long) (word >> 32));
+    return (int) idx + 32;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+/*!
+ * \brief Number of the set bits of a 64-bit word
+ */
+inline int _count_bits(uint64_t word) {
+#if defined(_MSC_VER)
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ((word * 0x0101010101010101ULL) >> 56);
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+/*!
+ * \brief Mask of the bits used by \a nbits bits in the \a w-th 64-bit word, i.e., all ones except the tail word
+ */
+inline uint64_t _bit_word_mask(int nbits, int w) {
+    int rest = nbits - w * 64;
+    return rest >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << rest) - 1;
+}
+
+/*!
+ * \brief Call \a func with the index of each set bit in packed 64-bit words, word at a time
+ * \param[in] words Packed bits, bit i % 64 of words[i / 64] for index i
+ * \param[in] nbits Number of bits
+ * \param[in] func Callable of void(int index)
+ */
+template<typename F>
+inline void _for_each_set_bit(const uint64_t *words, int nbits, F func) {
+    int nwords = (nbits + 63) / 64;
+    for (int w = 0; w < nwords; w++) {
+        uint64_t word = words[w] & _bit_word_mask(nbits, w);
+        while (word != 0) {
+            func(w * 64 + _lowest_bit_index(word));
+            word &= word - 1;  // clear the lowest set bit
+        }
+    }
+}
+
+/*!
+ * \brief Call \a func with the index of each clear bit in packed 64-bit words, \sa _for_each_set_bit
+ */
+template<typename F>
+inline void _for_each_clear_bit(const uint64_t *words, int nbits, F func) {
+    int nwords = (nbits + 63) / 64;
+    for (int w = 0; w < nwords; w++) {
+        uint64_t word = ~words[w] & _bit_word_mask(nbits, w);
+        while (word != 0) {
+            func(w * 64 + _lowest_bit_index(word));
+            word &= word - 1;
+        }
+    }
+}
+
+/*!
+ * \brief Release 2D array allocated by _initialize_2d_buffer
+ */
+template<typename T>
+inline void _release_2d_buffer(T **&data) {
+    if (nullptr == data) return;
+    _release_aligned_buffer(data[0]);
+    delete[] data;
+    data = nullptr;
+}
+
+/*!
+ * \brief Convert RasterCompression to string, e.g., "LZ4", which is stored in metadata
+ */
+inline string RasterCompressionToString(RasterCompression codec) {
+    switch (codec) {
+        case RCP_LZ4: return "LZ4";
+        case RCP_Zstd: return "ZSTD";
+        default: return "NONE";
+    }
+}
+
+/*!
+ * \brief Convert string to RasterCompression, case insensitive, empty string means RCP_None
+ * \param[in] str Compression string, \sa RasterCompressionToString
+ * \param[out] codec Compression
+ * \return false if \a str is unknown
+ */
+inline bool StringToRasterCompression(const string &str, RasterCompression &codec) {
+    codec = RCP_None;
+    if (str.empty() || StringMatch(str, "NONE")) return true;
+    if (StringMatch(str, "LZ4")) {
+        codec = RCP_LZ4;
+        return true;
+    }
+    if (StringMatch(str, "ZSTD")) {
+        codec = RCP_Zstd;
+        return true;
+    }
+    return false;
+}
+
+/*!
+ * \brief Is the given compression codec compiled in, i.e., USE_LZ4 or USE_ZSTD is defined
+ */
+inline bool RasterCompressionSupported(RasterCompression codec) {
+    switch (codec) {
+        case RCP_None: return true;
+#ifdef USE_LZ4
+        case RCP_LZ4: return true;
+#endif /* USE_LZ4 */
+#ifdef USE_ZSTD
+        case RCP_Zstd: return true;
+#endif /* USE_ZSTD */
+        default: return false;
+    }
+}
+
+/*!
+ * \brief Compress one block, \sa _compress_blocks
+ * \return Compressed size, 0 if failed or not compiled in
+ */
+inline size_t _compress_block(RasterCompression codec, const char *src, size_t length, char *dst, size_t capacity) {
+#if !defined(USE_LZ4) && !defined(USE_ZSTD)
+    (void) src; (void) length; (void) dst; (void) capacity;  /// no codec compiled in
+#endif
+    switch (codec) {
+#ifdef USE_LZ4
+        case RCP_LZ4: {
+            int n = LZ4_compress_default(src, dst, (int) length, (int) capacity);
+            return n > 0 ? (size_t) n : 0;
+        }
+#endif /* USE_LZ4 */
+#ifdef USE_ZSTD
+        case RCP_Zstd: {
+            size_t n = ZSTD_compress(dst, capacity, src, length, 1);
+            return ZSTD_isError(n) ? 0 : n;
+        }
+#endif /* USE_ZSTD */
+        default: return 0;
+    }
+}
+
+/*!
+ * \brief Upper bound of the compressed size of one block with \a length bytes
+ */
+inline size_t _compress_block_bound(RasterCompression codec, size_t length) {
+    switch (codec) {
+#ifdef USE_LZ4
+        case RCP_LZ4: return (size_t) LZ4_compressBound((int) length);
+#endif /* USE_LZ4 */
+#ifdef USE_ZSTD
+        case RCP_Zstd: return ZSTD_compressBound(length);
+#endif /* USE_ZSTD */
+        default: return length;
+    }
+}
+
+/*!
+ * \brief Decompress one block, \sa _decompress_blocks
+ * \return true if exactly \a rawLength bytes are decompressed
+ */
+inline bool _decompress_block(RasterCompression codec, const char *src, size_t length,
+                              char *dst, size_t rawLength) {
+#if !defined(USE_LZ4) && !defined(USE_ZSTD)
+    (void) src; (void) length; (void) dst; (void) rawLength;  /// no codec compiled in
+#endif
+    switch (codec) {
+#ifdef USE_LZ4
+        case RCP_LZ4:
+            return LZ4_decompress_safe(src, dst, (int) length, (int) rawLength) == (int) rawLength;
+#endif /* USE_LZ4 */
+#ifdef USE_ZSTD
+        case RCP_Zstd: {
+            size_t n = ZSTD_decompress(dst, rawLength, src, length);
+            return !ZSTD_isError(n) && n == rawLength;
+        }
+#endif /* USE_ZSTD */
+        default: return false;
+    }
+}
+
+/*!
+ * \brief Compress data into independent blocks in parallel.
+ *        The payload is a table of uint32 compressed sizes of blocks followed by the blocks.
+ *        A block which is not smaller after compression is stored raw, i.e., its size equals
+ *        the uncompressed block size, so that each block can be decoded independently.
+ * \param[in] codec Compression, MUST be supported, \sa RasterCompressionSupported
+ * \param[in] src Raw data
+ * \param[in] length Bytes of \a src
+ * \param[in] blockSize Uncompressed bytes of each block except the last one
+ * \param[out] dst Compressed payload
+ * \return false if compression failed
+ */
+inline bool _compress_blocks(RasterCompression codec, const char *src, size_t length, int blockSize,
+                             vector<char> &dst) {
+    int nblocks = (int) ((length + blockSize - 1) / blockSize);
+    vector<vector<char> > blocks(nblocks);
+    vector<uint32_t> sizes(nblocks, 0);
+    int failed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:failed)
+    for (int i = 0; i < nblocks; i++) {
+        size_t offset = (size_t) i * blockSize;
+        size_t rawsize = offset + blockSize > length ? length - offset : (size_t) blockSize;
+        blocks[i].resize(_compress_block_bound(codec, rawsize));
+        size_t n = _compress_block(codec, src + offset, rawsize, &blocks[i][0], blocks[i].size());
+        if (n == 0) {
+            failed++;
+            continue;
+        }
+        if (n >= rawsize) {  /// incompressible block is stored raw
+            memcpy(&blocks[i][0], src + offset, rawsize);
+            n = rawsize;
+        }
+        sizes[i] = (uint32_t) n;
+    }
+    if (failed > 0) return false;
+    size_t total = (size_t) nblocks * sizeof(uint32_t);
+    for (int i = 0; i < nblocks; i++) total += sizes[i];
+    dst.resize(total);
+    if (nblocks == 0) return true;
+    memcpy(&dst[0], &sizes[0], (size_t) nblocks * sizeof(uint32_t));
+    size_t offset = (size_t) nblocks * sizeof(uint32_t);
+    for (int i = 0; i < nblocks; i++) {
+        memcpy(&dst[offset], &blocks[i][0], sizes[i]);
+        offset += sizes[i];
+    }
+    return true;
+}
+
+/*!
+ * \brief Decompress the payload written by _compress_blocks in parallel.
+ * \param[in] codec Compression
+ * \param[in] src Compressed payload
+ * \param[in] length Bytes of \a src
+ * \param[in] blockSize Uncompressed bytes of each block except the last one
+ * \param[in] rawLength Uncompressed bytes
+ * \param[out] dst Allocated array with \a rawLength bytes
+ * \return false if the codec is not supported or the payload is corrupted
+ */
+inline bool _decompress_blocks(RasterCompression codec, const char *src, size_t length, int blockSize,
+                               size_t rawLength, char *dst) {
+    if (!RasterCompressionSupported(codec) || blockSize <= 0) return false;
+    int nblocks = (int) ((rawLength + blockSize - 1) / blockSize);
+    size_t tablesize = (size_t) nblocks * sizeof(uint32_t);
+    if (length < tablesize) return false;
+    /// offsets of blocks by prefix sum of the size table
+    vector<size_t> offsets(nblocks + 1, tablesize);
+    for (int i = 0; i < nblocks; i++) {
+        uint32_t n;
+        memcpy(&n, src + (size_t) i * sizeof(uint32_t), sizeof(uint32_t));
+        offsets[i + 1] = offsets[i] + n;
+    }
+    if (offsets[nblocks] != length) return false;
+    int failed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:failed)
+    for (int i = 0; i < nblocks; i++) {
+        size_t rawoffset = (size_t) i * blockSize;
+        size_t rawsize = rawoffset + blockSize > rawLength ? rawLength - rawoffset : (size_t) blockSize;
+        size_t n = offsets[i + 1] - offsets[i];
+        if (n == rawsize) {
+            memcpy(dst + rawoffset, src + offsets[i], rawsize);
+        } else if (!_decompress_block(codec, src + offsets[i], n, dst + rawoffset, rawsize)) {
+            failed++;
+        }
+    }
+    return failed == 0;
+}
+
+/*!
+ * \brief Format a floating point value as `ostream << setprecision(6) << value`, i.e., "%.6g",
+ *        by integer arithmetic. The rare cases which can not be decided by double precision,
+ *        e.g., nearly ties in rounding, zero, NaN, Inf, and extreme exponents, fall back to snprintf.
+ * \param[in] value Value to be formatted
+ * \param[out] buf Allocated char array with at least 32 elements, not null-terminated
+ * \return Length of the formatted text
+ */
+inline int _format_float_g6(double value, char *buf) {
+    static const double POW10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    double absv = value < 0. ? -value : value;
+    if (absv >= 1e-17 && absv < 1e22) {
+        /// decimal exponent, i.e., absv = m * 10^(e10-5) with 1e5 <= m < 1e6
+        int e10 = 0;
+        while (e10 < 21 && absv >= POW10[e10 + 1]) e10++;
+        while (e10 > -17 && absv * POW10[-e10] < 1.) e10--;
+        double m = 5 - e10 >= 0 ? absv * POW10[5 - e10] : absv / POW10[e10 - 5];
+        if (m < 1e5) {
+            m *= 10.;
+            e10--;
+        } else if (m >= 1e6) {
+            m /= 10.;
+            e10++;
+        }
+        double fl = floor(m);
+        double frac = m - fl;
+        if (m >= 1e5 && m < 1e6 && fabs(frac - 0.5) > 1e-6) {
+            int digits = (int) fl + (frac > 0.5 ? 1 : 0);
+            if (digits >= 1000000) {
+                digits /= 10;
+                e10++;
+            }
+            char d[6];
+            for (int i = 5; i >= 0; i--) {
+                d[i] = (char) ('0' + digits % 10);
+                digits /= 10;
+            }
+            int nd = 6;  /// remove trailing zeros
+            while (nd > 1 && d[nd - 1] == '0') nd--;
+            int len = 0;
+            if (value < 0.) buf[len++] = '-';
+            if (e10 >= -4 && e10 < 6) {  /// fixed notation
+                if (e10 >= 0) {
+                    for (int i = 0; i <= e10; i++) buf[len++] = i < nd ? d[i] : '0';
+                    if (nd > e10 + 1) {
+                        buf[len++] = '.';
+                        for (int i = e10 + 1; i < nd; i++) buf[len++] = d[i];
+                    }
+                } else {
+                    buf[len++] = '0';
+                    buf[len++] = '.';
+                    for (int i = 0; i < -e10 - 1; i++) buf[len++] = '0';
+                    for (int i = 0; i < nd; i++) buf[len++] = d[i];
+                }
+            } else {  /// scientific notation with at least two exponent digits
+                buf[len++] = d[0];
+                if (nd > 1) {
+                    buf[len++] = '.';
+                    for (int i = 1; i < nd; i++) buf[len++] = d[i];
+                }
+                buf[len++] = 'e';
+                buf[len++] = e10 < 0 ? '-' : '+';
+                int ae = e10 < 0 ? -e10 : e10;
+                if (ae >= 100) buf[len++] = (char) ('0' + ae / 100);
+                buf[len++] = (char) ('0' + ae / 10 % 10);
+                buf[len++] = (char) ('0' + ae % 10);
+            }
+            return len;
+        }
+    }
+    int len = snprintf(buf, 32, "%.6g", value);
+    return len < 0 ? 0 : len;
+}
+
+/*!
+ * \brief Format a value as `ostream << setprecision(6) << value` into \a buf, \sa _format_float_g6
+ * \return Length of the formatted text
+ */
+template<typename T>
+inline int _format_ascii_value(T value, char *buf, std::true_type /* is_floating_point */) {
+    return _format_float_g6((double) value, buf);
+}
+
+template<typename T>
+inline int _format_ascii_value(T value, char *buf, std::false_type /* is_floating_point */) {
+    if (std::is_integral<T>::value && sizeof(T) > sizeof(char) && !std::is_same<T, bool>::value) {
+        /// integer
+        char tmp[24];
+        int n = 0;
+        bool negative = value < (T) 0;
+        unsigned long long absv = negative ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+        do {
+            tmp[n++] = (char) ('0' + absv % 10);
+            absv /= 10;
+        } while (absv > 0);
+        int len = 0;
+        if (negative) buf[len++] = '-';
+        while (n > 0) buf[len++] = tmp[--n];
+        return len;
+    }
+    /// char types are written as characters by ostream
+    ostringstream oss;
+    oss << setprecision(6) << value;
+    string str = oss.str();
+    int len = str.size() > 31 ? 31 : (int) str.size();
+    memcpy(buf, str.c_str(), len);
+    return len;
+}
+
+template<typename T>
+inline int _format_ascii_value(T value, char *buf) {
+    return _format_ascii_value(value, buf, typename std::is_floating_point<T>::type());
+}
+
+/*!
+ * \brief Read the headers of ASC file, i.e., NCOLS, NROWS, XLLCENTER (or XLLCORNER), YLLCENTER (or YLLCORNER),
+ *        CELLSIZE, and NODATA_VALUE. The lower left corner is converted to the center of the lower left cell.
+ * \param[in] ifs ASC file stream, followed by the raster values if succeed
+ * \param[out] header Raster headers, LAYERS and CELLSNUM are not included
+ */
+inline bool _read_asc_headers(istream &ifs, map<string, double> &header) {
+    const char *RASTER_HEADERS[6] = {HEADER_RS_NCOLS, HEADER_RS_NROWS, HEADER_RS_XLL, HEADER_RS_YLL,
+                                     HEADER_RS_CELLSIZE, HEADER_RS_NODATA};
+    string keys[6];
+    for (int i = 0; i < 6; i++) {
+        double value = 0.;
+        ifs >> keys[i] >> value;
+        header[RASTER_HEADERS[i]] = value;
+    }
+    if (ifs.fail()) return false;
+    /// default is center, if corner, then:
+    if (StringMatch(keys[2], "XLLCORNER")) header.at(HEADER_RS_XLL) += 0.5 * header.at(HEADER_RS_CELLSIZE);
+    if (StringMatch(keys[3], "YLLCORNER")) header.at(HEADER_RS_YLL) += 0.5 * header.at(HEADER_RS_CELLSIZE);
+    return true;
+}
+
+/*!
+ * \brief Write the headers of ASC file, the existed file will be overwritten
+ * \param[in] filename ASC file path
+ * \param[in] header Raster headers, NCOLS, NROWS, XLLCENTER, YLLCENTER, CELLSIZE, and NODATA_VALUE are required
+ */
+inline bool _write_asc_headers(const string &filename, const map<string, double> &header) {
+    DeleteExistedFile(filename);
+    ofstream rasterFile(filename.c_str(), ios::app | ios::out);
+    if (!rasterFile.is_open()) {
+        print_status("Error opening file: " + filename);
+        return false;
+    }
+    //write file
+    int rows = int(header.at(HEADER_RS_NROWS));
+    int cols = int(header.at(HEADER_RS_NCOLS));
+    /// write header
+    rasterFile << HEADER_RS_NCOLS << " " << cols << endl;
+    rasterFile << HEADER_RS_NROWS << " " << rows << endl;
+    rasterFile << HEADER_RS_XLL << " " << header.at(HEADER_RS_XLL) << endl;
+    rasterFile << HEADER_RS_YLL << " " << header.at(HEADER_RS_YLL) << endl;
+    rasterFile << HEADER_RS_CELLSIZE << " " << (float) header.at(HEADER_RS_CELLSIZE) << endl;
+    rasterFile << HEADER_RS_NODATA << " " << setprecision(6) << header.at(HEADER_RS_NODATA) << endl;
+    rasterFile.close();
+    return true;
+}
+
+/*!
+ * \brief Geotransform of GDAL from the raster headers, i.e., north up and the origin is the upper left corner
+ * \param[in] header Raster headers, NROWS, XLLCENTER, YLLCENTER, and CELLSIZE are required
+ * \param[out] geoTrans Geotransform with the length of 6
+ */
+inline void _header_to_geotransform(const map<string, double> &header, double *geoTrans) {
+    double cellsize = header.at(HEADER_RS_CELLSIZE);
+    geoTrans[0] = header.at(HEADER_RS_XLL) - 0.5 * cellsize;
+    geoTrans[1] = cellsize;
+    geoTrans[2] = 0.;
+    geoTrans[3] = header.at(HEADER_RS_YLL) + (header.at(HEADER_RS_NROWS) - 0.5) * cellsize;
+    geoTrans[4] = 0.;
+    geoTrans[5] = -cellsize;
+}
+
+/*!
+ * \brief Raster headers of CELLSIZE, XLLCENTER, and YLLCENTER from the geotransform of GDAL, \sa _header_to_geotransform
+ * \param[in] geoTrans Geotransform with the length of 6
+ * \param[in] nRows Row number
+ * \param[out] header Raster headers
+ */
+inline void _geotransform_to_header(const double *geoTrans, int nRows, map<string, double> &header) {
+    header[HEADER_RS_CELLSIZE] = geoTrans[1];
+    header[HEADER_RS_XLL] = geoTrans[0] + 0.5 * geoTrans[1];
+    header[HEADER_RS_YLL] = geoTrans[3] + (nRows - 0.5) * geoTrans[5];
+}
+
+/*!
+ * \brief Write a string into binary stream, i.e., the length followed by the characters
+ */
+inline void _write_binary_string(ofstream &ofs, const string &str) {
+    int len = (int) str.size();
+    ofs.write((const char *) &len, sizeof(int));
+    if (len > 0) ofs.write(str.c_str(), len);
+}
+
+/*!
+ * \brief Bytes from the current position to the end of binary stream, 0 if the stream is failed
+ */
+inline uint64_t _remaining_stream_bytes(ifstream &ifs) {
+    if (!ifs) return 0;
+    streampos cur = ifs.tellg();
+    ifs.seekg(0, ios::end);
+    streampos end = ifs.tellg();
+    ifs.seekg(cur);
+    return end > cur ? (uint64_t) (end - cur) : 0;
+}
+
+/*!
+ * \brief Read a string written by _write_binary_string()
+ */
+inline bool _read_binary_string(ifstream &ifs, string &str) {
+    int len = -1;
+    ifs.read((char *) &len, sizeof(int));
+    if (!ifs || len < 0 || (uint64_t) len > _remaining_stream_bytes(ifs)) return false;
+    str.assign(len, '\0');
+    if (len > 0) ifs.read(&str[0], len);
+    return !ifs.fail();
+}
+
+#ifdef USE_MONGODB
+
+/*!
+ * \struct GridFSRasterPayload
+ * \brief Description of the payload of raster stored in GridFS, which is parsed from metadata.
+ */
+struct GridFSRasterPayload {
+    RasterDataType dataType;        ///< Data type of values, FLOAT32 if not recorded
+    string layout;                  ///< Empty (full-sized and pixel interleaved), COMPACT, or BAND
+    int runsNumber;                 ///< Number of runs of the COMPACT layout
+    bool compressionKnown;          ///< The recorded compression is known or not
+    RasterCompression compression;  ///< Block compression
+    int blockSize;                  ///< Uncompressed bytes of compression blocks
+    size_t rawLength;               ///< Uncompressed bytes of payload
+};
+
+/*!
+ * \brief Parse the raster headers, SRS, and payload description from the metadata of GridFS file
+ * \param[in] bmeta Metadata
+ * \param[out] header Raster headers
+ * \param[out] srs Coordinate system string
+ * \param[out] payload Payload description
+ */
+inline void _parse_gridfs_metadata(bson_t *bmeta, map<string, double> &header, string &srs,
+                                   GridFSRasterPayload &payload) {
+    const char *RASTER_HEADERS[8] = {HEADER_RS_NCOLS, HEADER_RS_NROWS, HEADER_RS_XLL, HEADER_RS_YLL, HEADER_RS_CELLSIZE,
+                                     HEADER_RS_NODATA, HEADER_RS_LAYERS, HEADER_RS_CELLSNUM};
+    for (int i = 0; i < 8; i++) {
+        GetNumericFromBson(bmeta, RASTER_HEADERS[i], header[RASTER_HEADERS[i]]);
+    }
+    srs = GetStringFromBson(bmeta, HEADER_RS_SRS);
+    /// Data stored before DATATYPE is introduced is always float
+    payload.dataType = RDT_Float;
+    string dtypestr = GetStringFromBson(bmeta, HEADER_RS_DATATYPE);
+    if (!dtypestr.empty()) payload.dataType = StringToRasterDataType(dtypestr);
+    payload.layout = GetStringFromBson(bmeta, HEADER_RS_LAYOUT);
+    double value = 0.;
+    payload.runsNumber = 0;
+    if (GetNumericFromBson(bmeta, HEADER_RS_RUNSNUM, value)) payload.runsNumber = (int) value;
+    payload.compressionKnown = StringToRasterCompression(GetStringFromBson(bmeta, HEADER_RS_COMPRESSION),
+                                                         payload.compression);
+    payload.blockSize = 0;
+    payload.rawLength = 0;
+    if (GetNumericFromBson(bmeta, HEADER_RS_BLOCKSIZE, value)) payload.blockSize = (int) value;
+    if (GetNumericFromBson(bmeta, HEADER_RS_RAWLENGTH, value)) payload.rawLength = (size_t) value;
+}
+
+/*!
+ * \brief Read \a bytes bytes from \a offset of the GridFS file, only the covered chunks are fetched
+ * \param[in] gfile Opened GridFS file
+ * \param[in] offset Offset in bytes
+ * \param[in] bytes Bytes to read
+ * \param[out] dst Allocated array with \a bytes bytes
+ */
+inline bool _read_gridfs_bytes(mongoc_gridfs_file_t *gfile, size_t offset, size_t bytes, char *dst) {
+    if (mongoc_gridfs_file_seek(gfile, (int64_t) offset, SEEK_SET) != 0) return false;
+    size_t done = 0;
+    while (done < bytes) {
+        mongoc_iovec_t iov;
+        iov.iov_base = dst + done;
+        iov.iov_len = bytes - done;
+        ssize_t nread = mongoc_gridfs_file_readv(gfile, &iov, 1, 0, 0);
+        if (nread <= 0) return false;
+        done += (size_t) nread;
+    }
+    return true;
+}
+
+/*!
+ * \brief Read a range of the uncompressed payload of the GridFS file.
+ *        For the block compressed payload, only the blocks covering the range are fetched and decoded.
+ * \param[in] gfile Opened GridFS file
+ * \param[in] payload Payload description
+ * \param[in] blockOffsets Offsets of compressed blocks, i.e., the prefix sum of the size table,
+ *            with the length of block number + 1. Empty if not compressed.
+ * \param[in] offset Offset in bytes of the uncompressed payload
+ * \param[in] bytes Bytes to read
+ * \param[out] dst Allocated array with \a bytes bytes
+ */
+inline bool _read_gridfs_range(mongoc_gridfs_file_t *gfile, const GridFSRasterPayload &payload,
+                               const vector<size_t> &blockOffsets, size_t offset, size_t bytes, char *dst) {
+    if (bytes == 0) return true;
+    if (payload.compression == RCP_None) return _read_gridfs_bytes(gfile, offset, bytes, dst);
+    size_t bs = (size_t) payload.blockSize;
+    int b0 = (int) (offset / bs);
+    int b1 = (int) ((offset + bytes - 1) / bs);
+    if (b1 + 1 >= (int) blockOffsets.size()) return false;
+    vector<char> compressed(blockOffsets[b1 + 1] - blockOffsets[b0]);
+    if (!compressed.empty() &&
+        !_read_gridfs_bytes(gfile, blockOffsets[b0], compressed.size(), &compressed[0])) {
+        return false;
+    }
+    int failed = 0;
+#pragma omp parallel for reduction(+:failed)
+    for (int b = b0; b <= b1; b++) {
+        size_t rawoffset = (size_t) b * bs;
+        size_t rawsize = rawoffset + bs > payload.rawLength ? payload.rawLength - rawoffset : bs;
+        size_t n = blockOffsets[b + 1] - blockOffsets[b];
+        const char *src = n > 0 ? &compressed[blockOffsets[b] - blockOffsets[b0]] : nullptr;
+        vector<char> block(rawsize);
+        if (n == rawsize) {
+            memcpy(&block[0], src, rawsize);
+        } else if (!_decompress_block(payload.compression, src, n, &block[0], rawsize)) {
+            failed++;
+            continue;
+        }
+        /// copy the overlapped part
+        size_t start = offset > rawoffset ? offset : rawoffset;
+        size_t end = offset + bytes < rawoffset + rawsize ? offset + bytes : rawoffset + rawsize;
+        memcpy(dst + (start - offset), &block[start - rawoffset], end - start);
+    }
+    return failed == 0;
+}
+
+/*!
+ * \brief Read the size table of the block compressed payload, \sa _compress_blocks
+ * \param[in] gfile Opened GridFS file
+ * \param[in] payload Payload description
+ * \param[out] blockOffsets Offsets of compressed blocks, empty if not compressed
+ */
+inline bool _read_gridfs_block_offsets(mongoc_gridfs_file_t *gfile, const GridFSRasterPayload &payload,
+                                       vector<size_t> &blockOffsets) {
+    blockOffsets.clear();
+    if (!payload.compressionKnown) return false;
+    if (payload.compression == RCP_None) return true;
+    if (!RasterCompressionSupported(payload.compression) || payload.blockSize <= 0) return false;
+    int nblocks = (int) ((payload.rawLength + payload.blockSize - 1) / payload.blockSize);
+    vector<uint32_t> sizes(nblocks);
+    if (nblocks > 0 && !_read_gridfs_bytes(gfile, 0, nblocks * sizeof(uint32_t), (char *) &sizes[0])) {
+        return false;
+    }
+    blockOffsets.resize(nblocks + 1, (size_t) nblocks * sizeof(uint32_t));
+    for (int i = 0; i < nblocks; i++) {
+        blockOffsets[i + 1] = blockOffsets[i] + sizes[i];
+    }
+    return blockOffsets[nblocks] == (size_t) mongoc_gridfs_file_get_length(gfile);
+}
+
+/*!
+ * \brief Read a window of rows and a subset of layers of raster stored in GridFS.
+ *        Only the GridFS chunks (or compressed blocks) covering the window are fetched.
+ * \param[in] gfs \a MongoGridFS
+ * \param[in] filename Raster file name
+ * \param[in] rowStart First row of the window, starts from 0
+ * \param[in] rowCount Row number of the window
+ * \param[in,out] layers Layers to read, starts from 1, all layers if empty
+ * \param[out] header Raster headers of the whole raster
+ * \param[out] srs Coordinate system string
+ * \param[out] payload Payload description
+ * \param[out] buf Window data allocated by new[], which keeps the interleave of payload, i.e.,
+ *             (cell, layer) for pixel interleaved, (layer, cell) for band interleaved
+ * \return false if the raster is stored as the COMPACT layout, or the window is out of extent
+ */
+inline bool _read_gridfs_window(MongoGridFS *gfs, const string &filename, int rowStart, int rowCount,
+                                vector<int> &layers, map<string, double> &header, string &srs,
+                                GridFSRasterPayload &payload, char *&buf) {
+    /// 1. Get metadata by file name and check the window
+    bson_t *bmeta = gfs->getFileMetadata(filename);
+    if (nullptr == bmeta) {
+        print_status("Failed to read " + filename + " from MongoDB!");
+        return false;
+    }
+    _parse_gridfs_metadata(bmeta, header, srs, payload);
+    bson_destroy(bmeta);
+    int nRows = (int) header.at(HEADER_RS_NROWS);
+    int nCols = (int) header.at(HEADER_RS_NCOLS);
+    int nLyrs = (int) header.at(HEADER_RS_LAYERS);
+    int esize = _get_raster_data_type_size(payload.dataType);
+    bool band = StringMatch(payload.layout, GridFSLayoutBand);
+    if (StringMatch(payload.layout, GridFSLayoutCompact) || esize == 0) {
+        print_status("Windowed read of " + filename + " is not supported by its layout or data type!");
+        return false;
+    }
+    if (layers.empty()) {
+        for (int lyr = 1; lyr <= nLyrs; lyr++) layers.emplace_back(lyr);
+    }
+    bool validwindow = rowStart >= 0 && rowCount > 0 && rowStart + rowCount <= nRows;
+    for (auto it = layers.begin(); it != layers.end(); it++) {
+        if (*it < 1 || *it > nLyrs) validwindow = false;
+    }
+    if (!validwindow) {
+        print_status("The window is out of the extent of " + filename + "!");
+        return false;
+    }
+    mongoc_gridfs_file_t *gfile = gfs->getFile(filename);
+    if (nullptr == gfile) {
+        print_status("Failed to read " + filename + " from MongoDB!");
+        return false;
+    }
+    size_t fulllength = (size_t) nRows * nCols * nLyrs * esize;
+    vector<size_t> blockoffsets;
+    if ((payload.compression == RCP_None ? (size_t) mongoc_gridfs_file_get_length(gfile) : payload.rawLength)
+        != fulllength || !_read_gridfs_block_offsets(gfile, payload, blockoffsets)) {
+        print_status("The length or compression of " + filename + " is inconsistent with the metadata!");
+        mongoc_gridfs_file_destroy(gfile);
+        return false;
+    }
+    /// 2. Fetch the chunks covering the window only, the window data keeps the interleave of payload
+    int nsel = (int) layers.size();
+    size_t wincells = (size_t) rowCount * nCols;
+    buf = new char[wincells * nsel * esize];
+    bool fetched = true;
+    if (band) {
+        /// each layer of the window is contiguous
+        for (int i = 0; i < nsel && fetched; i++) {
+            size_t offset = ((size_t) (layers[i] - 1) * nRows * nCols + (size_t) rowStart * nCols) * esize;
+            fetched = _read_gridfs_range(gfile, payload, blockoffsets, offset, wincells * esize,
+                                         buf + i * wincells * esize);
+        }
+    } else {
+        /// rows of the window are contiguous, but include all layers
+        char *rows = new char[wincells * nLyrs * esize];
+        fetched = _read_gridfs_range(gfile, payload, blockoffsets, (size_t) rowStart * nCols * nLyrs * esize,
+                                     wincells * nLyrs * esize, rows);
+        if (fetched) {
+#pragma omp parallel for
+            for (int i = 0; i < (int) wincells; i++) {
+                for (int k = 0; k < nsel; k++) {
+                    memcpy(buf + ((size_t) i * nsel + k) * esize,
+                           rows + ((size_t) i * nLyrs + layers[k] - 1) * esize, esize);
+                }
+            }
+        }
+        delete[] rows;
+    }
+    mongoc_gridfs_file_destroy(gfile);
+    if (!fetched) {
+        print_status("Failed to read the window of " + filename + " from MongoDB!");
+        delete[] buf;
+        buf = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief Write the payload of raster into GridFS with the raster headers as metadata
+ * \param[in] gfs \a MongoGridFS
+ * \param[in] filename Raster file name, the existed file will be replaced
+ * \param[in] header Raster headers
+ * \param[in] srs Coordinate system string
+ * \param[in] dtype Data type of values
+ * \param[in] layout Empty (full-sized and pixel interleaved), COMPACT, or BAND
+ * \param[in] buf Payload
+ * \param[in] length Bytes of payload
+ * \param[in] codec Block compression, fall back to the raw payload if failed
+ * \param[in] blockSize Uncompressed bytes of compression blocks
+ */
+inline void _write_gridfs_payload(MongoGridFS *gfs, const string &filename, const map<string, double> &header,
+                                  const string &srs, RasterDataType dtype, const string &layout,
+                                  const char *buf, size_t length, RasterCompression codec, int blockSize) {
+    bson_t p = BSON_INITIALIZER;
+    for (auto iter = header.begin(); iter != header.end(); iter++) {
+        BSON_APPEND_DOUBLE(&p, iter->first.c_str(), iter->second);
+    }
+    BSON_APPEND_UTF8(&p, HEADER_RS_SRS, srs.c_str());
+    BSON_APPEND_UTF8(&p, HEADER_RS_DATATYPE, RasterDataTypeToString(dtype).c_str());
+    if (!layout.empty()) BSON_APPEND_UTF8(&p, HEADER_RS_LAYOUT, layout.c_str());
+    char *data = const_cast<char *>(buf);
+    /// compressed into independent blocks
+    vector<char> compressed;
+    if (codec != RCP_None && _compress_blocks(codec, buf, length, blockSize, compressed)) {
+        BSON_APPEND_UTF8(&p, HEADER_RS_COMPRESSION, RasterCompressionToString(codec).c_str());
+        BSON_APPEND_DOUBLE(&p, HEADER_RS_BLOCKSIZE, blockSize);
+        BSON_APPEND_DOUBLE(&p, HEADER_RS_RAWLENGTH, (double) length);
+        data = compressed.empty() ? nullptr : &compressed[0];
+        length = compressed.size();
+    }
+    gfs->writeStreamData(filename, data, length, &p);
+    bson_destroy(&p);
+}
+
+/*!
+ * \brief Node-local cache directory of GridFS rasters, empty means disabled
+ */
+inline string &_gridfs_cache_directory() {
+    static string cachedir;
+    return cachedir;
+}
+
+/*!
+ * \brief Set the node-local cache directory of GridFS rasters, which should be set before reading.
+ *        The decoded payload read by clsRasterData::ReadFromMongoDB() is cached by the content hash
+ *        of the GridFS file, so the other processes on the same node read it from local disk
+ *        (or page cache) instead of the database. The cache files can be removed at any time.
+ * \param[in] dir Existing directory, empty to disable the cache
+ */
+inline bool SetGridFSCacheDirectory(const string &dir) {
+    if (!dir.empty() && !DirectoryExists(dir)) {
+        print_status("The cache directory " + dir + " does not exist!");
+        return false;
+    }
+    _gridfs_cache_directory() = dir;
+    return true;
+}
+
+//! Get the node-local cache directory of GridFS rasters, empty means disabled
+inline string GetGridFSCacheDirectory() { return _gridfs_cache_directory(); }
+
+/*!
+ * \brief Get the cache file name of GridFS file, which is keyed by md5,
+ *        or by _id and upload date if md5 is not available.
+ */
+inline string _gridfs_cache_filename(mongoc_gridfs_file_t *gfile) {
+    string key;
+    const char *md5 = mongoc_gridfs_file_get_md5(gfile);
+    if (nullptr != md5 && md5[0] != '\0') {
+        key = string("md5_") + md5;
+    } else {
+        const bson_value_t *id = mongoc_gridfs_file_get_id(gfile);
+        if (nullptr == id || id->value_type != BSON_TYPE_OID) return "";  /// not cached, e.g., custom _id
+        char oid[25];
+        bson_oid_to_string(&id->value.v_oid, oid);
+        key = string(oid) + "_" + ValueToString(mongoc_gridfs_file_get_upload_date(gfile));
+    }
+    string dir = _gridfs_cache_directory();
+    if (dir.back() != '/' && dir.back() != '\\') dir += SEP;
+    return dir + key + "." + GridFSCacheExtension;
+}
+
+/*!
+ * \brief Read the decoded payload from cache file
+ * \param[in] cachefile Cache file name, \sa _gridfs_cache_filename
+ * \param[out] buf Payload allocated by new[]
+ * \param[out] length Bytes of payload
+ * \return false if not cached
+ */
+inline bool _read_gridfs_cache(const string &cachefile, char *&buf, size_t &length) {
+    ifstream ifs(cachefile.c_str(), ios::in | ios::binary);
+    if (!ifs.is_open()) return false;
+    char magic[8];
+    uint64_t bytes = 0;
+    ifs.read(magic, 8);
+    ifs.read((char *) &bytes, sizeof(uint64_t));
+    if (!ifs || memcmp(magic, GridFSCacheMagic, 8) != 0) return false;
+    /// the length must match the file, e.g., not truncated or corrupted, before allocating
+    if (bytes != _remaining_stream_bytes(ifs)) return false;
+    buf = new char[(size_t) bytes];
+    if (bytes > 0) ifs.read(buf, (streamsize) bytes);
+    if (ifs.fail() || ifs.gcount() != (streamsize) bytes) {
+        delete[] buf;
+        buf = nullptr;
+        return false;
+    }
+    length = (size_t) bytes;
+    return true;
+}
+
+/*!
+ * \brief Write the decoded payload to cache file, i.e., the magic, the bytes of payload, and the payload.
+ *        It is written to a temporary file which is then renamed, so the concurrent
+ *        populations by several processes are safe and a partial cache file never appears.
+ * \param[in] cachefile Cache file name, \sa _gridfs_cache_filename
+ * \param[in] buf Payload
+ * \param[in] length Bytes of payload
+ */
+inline bool _write_gridfs_cache(const string &cachefile, const char *buf, size_t length) {
+    random_device rd;
+    string tmpfile = cachefile + "." + ValueToString(rd()) + ValueToString(rd()) + ".tmp";
+    ofstream ofs(tmpfile.c_str(), ios::out | ios::binary);
+    if (!ofs.is_open()) return false;
+    char magic[8] = GridFSCacheMagic;
+    uint64_t bytes = length;
+    ofs.write(magic, 8);
+    ofs.write((const char *) &bytes, sizeof(uint64_t));
+    if (length > 0) ofs.write(buf, (streamsize) length);
+    bool written = !ofs.fail();
+    ofs.close();
+    /// the rename fails if another process has populated the cache on some platforms, e.g., Windows
+    if (!written || rename(tmpfile.c_str(), cachefile.c_str()) != 0) {
+        remove(tmpfile.c_str());
+        return written && FileExists(cachefile);
+    }
+    return true;
+}
+
+/*!
+ * \brief Parse the raster headers from metadata of GridFS file, \sa _parse_gridfs_metadata
+ * \return false and \a header is cleared if NROWS or NCOLS is absent, e.g., not a raster
+ */
+inline bool _parse_gridfs_header(bson_t *bmeta, map<string, double> &header, string &srs) {
+    header.clear();
+    double value = 0.;
+    if (!GetNumericFromBson(bmeta, HEADER_RS_NROWS, value) || !GetNumericFromBson(bmeta, HEADER_RS_NCOLS, value)) {
+        return false;
+    }
+    GridFSRasterPayload payload;
+    _parse_gridfs_metadata(bmeta, header, srs, payload);
+    return true;
+}
+
+/*!
+ * \brief Read the raster headers of GridFS file from its metadata only, i.e., the payload is not fetched
+ * \param[in] gfs \a MongoGridFS
+ * \param[in] filename Raster file name
+ * \param[out] header Raster headers, e.g., NROWS, NCOLS, CELLSIZE, LAYERS, and CELLSNUM
+ * \param[out] srs Coordinate system string, optional
+ * \return false if not found or NROWS or NCOLS is absent, and \a header is cleared for the latter
+ */
+inline bool ReadRasterHeaderFromMongoDB(MongoGridFS *gfs, const string &filename, map<string, double> &header,
+                                        string *srs = nullptr) {
+    bson_t *bmeta = gfs->getFileMetadata(filename);
+    if (nullptr == bmeta) {
+        print_status("Failed to read the metadata of " + filename + " from MongoDB!");
+        return false;
+    }
+    string tmpsrs;
+    bool flag = _parse_gridfs_header(bmeta, header, tmpsrs);
+    bson_destroy(bmeta);
+    if (!flag) {
+        print_status("The metadata of " + filename + " has no NROWS or NCOLS!");
+        return false;
+    }
+    if (nullptr != srs) *srs = tmpsrs;
+    return true;
+}
+
+/*!
+ * \brief Read the raster headers of several GridFS files by one query of the files collection,
+ *        \sa ReadRasterHeaderFromMongoDB
+ * \param[in] gfs \a MongoGridFS
+ * \param[in] filenames Raster file names
+ * \param[out] headers Raster headers of the newest revision keyed by file name,
+ *             the files not found or without NROWS or NCOLS are absent
+ * \param[out] srs Coordinate system strings keyed by file name, optional
+ * \return Number of files found
+ */
+inline int ReadRasterHeadersFromMongoDB(MongoGridFS *gfs, const vector<string> &filenames,
+                                        map<string, map<string, double> > &headers,
+                                        map<string, string> *srs = nullptr) {
+    headers.clear();
+    if (nullptr != srs) srs->clear();
+    if (filenames.empty()) return 0;
+    /// {"filename": {"$in": [filenames]}}
+    bson_t filter = BSON_INITIALIZER;
+    bson_t child;
+    bson_t names;
+    bson_append_document_begin(&filter, "filename", -1, &child);
+    bson_append_array_begin(&child, "$in", -1, &names);
+    for (int i = 0; i < (int) filenames.size(); i++) {
+        BSON_APPEND_UTF8(&names, ValueToString(i).c_str(), filenames[i].c_str());
+    }
+    bson_append_array_end(&child, &names);
+    bson_append_document_end(&filter, &child);
+    /// {"sort": {"uploadDate": -1}}, i.e., the newest revision of each file comes first
+    bson_t opts = BSON_INITIALIZER;
+    bson_t sort;
+    bson_append_document_begin(&opts, "sort", -1, &sort);
+    BSON_APPEND_INT32(&sort, "uploadDate", -1);
+    bson_append_document_end(&opts, &sort);
+    mongoc_gridfs_file_list_t *list = mongoc_gridfs_find_with_opts(gfs->getGridFS(), &filter, &opts);
+    bson_destroy(&filter);
+    bson_destroy(&opts);
+    if (nullptr == list) return 0;
+    mongoc_gridfs_file_t *gfile = nullptr;
+    set<string> parsed;  /// file names whose newest revision has been parsed
+    while (nullptr != (gfile = mongoc_gridfs_file_list_next(list))) {
+        bson_t *bmeta = const_cast<bson_t *>(mongoc_gridfs_file_get_metadata(gfile));
+        const char *name = mongoc_gridfs_file_get_filename(gfile);
+        if (nullptr != bmeta && nullptr != name && parsed.insert(name).second) {
+            string tmpsrs;
+            map<string, double> header;
+            if (_parse_gridfs_header(bmeta, header, tmpsrs)) {
+                headers[name] = header;
+                if (nullptr != srs) (*srs)[name] = tmpsrs;
+            }
+        }
+        mongoc_gridfs_file_destroy(gfile);
+    }
+    bson_error_t err;
+    if (mongoc_gridfs_file_list_error(list, &err)) {
+        print_status("Failed to query the metadata from MongoDB: " + string(err.message));
+    }
+    mongoc_gridfs_file_list_destroy(list);
+    return (int) headers.size();
+}
+
+/*!
+ * \brief Process items by worker threads, each pops a client from \a pool and takes the remaining items one by one.
+ *        The OpenMP threads of each worker are limited to its share of omp_get_max_threads(), so the
+ *        parallel regions inside \a process, e.g., decoding and scattering of rasters, do not oversubscribe cores.
+ * \param[in] pool \a mongoc_client_pool_t, the maximum size should be no less than \a nThreads
+ * \param[in] dbname Database name
+ * \param[in] gfsname GridFS prefix
+ * \param[in] nItems Number of items
+ * \param[in] nThreads Number of worker threads, 0 means the number of hardware threads
+ * \param[in] process Called with the item index and GridFS of the worker, which is nullptr if failed to get
+ *            the GridFS, so that each item is still processed once
+ */
+inline void _run_gridfs_workers(mongoc_client_pool_t *pool, const string &dbname, const string &gfsname,
+                                int nItems, int nThreads, const function<void(int, MongoGridFS *)> &process) {
+    if (nThreads <= 0) nThreads = (int) thread::hardware_concurrency();
+    if (nThreads <= 0) nThreads = 1;
+    if (nThreads > nItems) nThreads = nItems;
+    int ompThreads = 1;
+#ifdef SUPPORT_OMP
+    ompThreads = omp_get_max_threads() / nThreads;
+    if (ompThreads < 1) ompThreads = 1;
+#endif /* SUPPORT_OMP */
+    atomic<int> next(0);
+    vector<thread> workers;
+    for (int t = 0; t < nThreads; t++) {
+        workers.emplace_back([&]() {
+#ifdef SUPPORT_OMP
+            omp_set_num_threads(ompThreads);  /// affects the parallel regions started by this worker only
+#endif /* SUPPORT_OMP */
+            mongoc_client_t *client = mongoc_client_pool_pop(pool);
+            bson_error_t err;
+            mongoc_gridfs_t *gridfs = mongoc_client_get_gridfs(client, dbname.c_str(), gfsname.c_str(), &err);
+            MongoGridFS *gfs = nullptr;
+            if (nullptr == gridfs) {
+                print_status("Failed to get GridFS " + gfsname + " of " + dbname + "!");
+            } else {
+                gfs = new MongoGridFS(gridfs);
+            }
+            for (int i = next++; i < nItems; i = next++) {
+                process(i, gfs);
+            }
+            if (nullptr != gfs) delete gfs;  /// destroys \a gridfs before the client is pushed back
+            mongoc_client_pool_push(pool, client);
+        });
+    }
+    for (auto it = workers.begin(); it != workers.end(); it++) {
+        it->join();
+    }
+}
+
+#endif /* USE_MONGODB */
+
+/*!
+ * \brief Check the window of rows of layer is in the extent of raster
+ * \param[in] header Raster headers, NROWS and LAYERS are required
+ * \param[in] lyr Layer, starts from 1
+ * \param[in] rowStart First row of the window, starts from 0
+ * \param[in] rowCount Row number of the window
+ */
+inline bool _valid_raster_window(const map<string, double> &header, int lyr, int rowStart, int rowCount) {
+    int nRows = (int) header.at(HEADER_RS_NROWS);
+    int nLyrs = (int) header.at(HEADER_RS_LAYERS);
+    return lyr >= 1 && lyr <= nLyrs && rowStart >= 0 && rowCount > 0 && rowStart + rowCount <= nRows;
+}
+
+/*!
+ * \class clsRasterStorage
+ * \ingroup data
+ * \brief Abstract storage backend of rasters, \sa clsRasterData::ReadFromStorage, clsRasterData::outputToStorage
+ *
+ *        A raster is identified by its name in the backend and consists of LAYERS layers of
+ *        NROWS * NCOLS cells. Windows are whole rows of one layer, values are exchanged as double
+ *        in row-major order. The headers are the same as clsRasterData::getRasterHeader, i.e.,
+ *        XLLCENTER and YLLCENTER are the center of the lower left cell.
+ *        Unless otherwise stated, a backend instance should not be used by several threads concurrently.
+ */
+class clsRasterStorage {
+public:
+    virtual ~clsRasterStorage() {}
+
+    /*!
+     * \brief Open an existed raster and get its metadata
+     * \param[in] name Raster name
+     * \param[out] header Raster headers, including LAYERS
+     * \param[out] srs Coordinate system string, empty if not supported by the backend
+     */
+    virtual bool open(const string &name, map<string, double> &header, string &srs) = 0;
+
+    /*!
+     * \brief Create a raster filled with NODATA_VALUE, the existed raster will be replaced
+     * \param[in] name Raster name
+     * \param[in] header Raster headers, NCOLS, NROWS, XLLCENTER, YLLCENTER, CELLSIZE, NODATA_VALUE,
+     *            and LAYERS are required
+     * \param[in] srs Coordinate system string
+     */
+    virtual bool create(const string &name, const map<string, double> &header, const string &srs) = 0;
+
+    /*!
+     * \brief Read a window of rows of one layer
+     * \param[in] name Raster name
+     * \param[in] lyr Layer, starts from 1
+     * \param[in] rowStart First row of the window, starts from 0
+     * \param[in] rowCount Row number of the window
+     * \param[out] values Allocated array with the length of rowCount * NCOLS
+     */
+    virtual bool readWindow(const string &name, int lyr, int rowStart, int rowCount, double *values) = 0;
+
+    /*!
+     * \brief Write a window of rows of one layer
+     * \param[in] name Raster name
+     * \param[in] lyr Layer, starts from 1
+     * \param[in] rowStart First row of the window, starts from 0
+     * \param[in] rowCount Row number of the window
+     * \param[in] values Array with the length of rowCount * NCOLS
+     */
+    virtual bool writeWindow(const string &name, int lyr, int rowStart, int rowCount, const double *values) = 0;
+};
+
+/*!
+ * \class clsRasterStorageMemory
+ * \ingroup data
+ * \brief In-memory storage backend, e.g., for tests and intermediate rasters of workflows.
+ *        It is safe to be used by several threads concurrently.
+ *
+ *        clsRasterData::outputToStorage keeps a typed snapshot (compact if the positions are calculated)
+ *        by a RasterHandle instead of full size double values, and clsRasterData::ReadFromStorage copies it
+ *        back directly if the data type matches. The snapshot is converted to double values on demand,
+ *        i.e., by readWindow, or once for all by the first writeWindow.
+ */
+class clsRasterStorageMemory : public clsRasterStorage {
+public:
+    /*!
+     * \brief Raster stored in its own data type and layout, which is immutable once attached
+     */
+    class RasterHandle {
+    public:
+        virtual ~RasterHandle() {}
+
+        /*!
+         * \brief Convert a window of rows of one layer to double, \sa clsRasterStorage::readWindow
+         * \param[in] lyr Layer, starts from 1
+         */
+        virtual void readWindow(int lyr, int rowStart, int rowCount, double *values) const = 0;
+    };
+
+    bool open(const string &name, map<string, double> &header, string &srs) override {
+        lock_guard<mutex> lock(m_mutex);
+        auto it = m_rasters.find(name);
+        if (it == m_rasters.end()) return false;
+        header = it->second.header;
+        srs = it->second.srs;
+        return true;
+    }
+
+    bool create(const string &name, const map<string, double> &header, const string &srs) override {
+        size_t n = (size_t) header.at(HEADER_RS_NROWS) * (size_t) header.at(HEADER_RS_NCOLS) *
+            (size_t) header.at(HEADER_RS_LAYERS);
+        lock_guard<mutex> lock(m_mutex);
+        MemoryRaster &raster = m_rasters[name];
+        raster.header = header;
+        raster.srs = srs;
+        raster.values.assign(n, header.at(HEADER_RS_NODATA));
+        raster.handle.reset();
+        return true;
+    }
+
+    /*!
+     * \brief Store a raster by its handle without conversion, the existed raster will be replaced
+     * \param[in] name Raster name
+     * \param[in] header Raster headers, the same as create
+     * \param[in] srs Coordinate system string
+     * \param[in] handle Raster handle, shared by the backend
+     */
+    bool attach(const string &name, const map<string, double> &header, const string &srs,
+                const shared_ptr<const RasterHandle> &handle) {
+        if (nullptr == handle) return false;
+        lock_guard<mutex> lock(m_mutex);
+        MemoryRaster &raster = m_rasters[name];
+        raster.header = header;
+        raster.srs = srs;
+        vector<double>().swap(raster.values);
+        raster.handle = handle;
+        return true;
+    }
+
+    //! Get the handle of raster, nullptr if not existed or stored as double values
+    shared_ptr<const RasterHandle> getHandle(const string &name) {
+        lock_guard<mutex> lock(m_mutex);
+        auto it = m_rasters.find(name);
+        if (it == m_rasters.end()) return nullptr;
+        return it->second.handle;
+    }
+
+    bool readWindow(const string &name, int lyr, int rowStart, int rowCount, double *values) override {
+        size_t offset = 0;
+        size_t n = 0;
+        shared_ptr<const RasterHandle> handle;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            auto it = m_rasters.find(name);
+            if (it == m_rasters.end() || !_window_range(it->second, lyr, rowStart, rowCount, offset, n)) return false;
+            if (nullptr == it->second.handle) {
+                memcpy(values, &it->second.values[offset], n * sizeof(double));
+                return true;
+            }
+            handle = it->second.handle;
+        }
+        /// the handle is immutable, convert without holding the lock
+        handle->readWindow(lyr, rowStart, rowCount, values);
+        return true;
+    }
+
+    bool writeWindow(const string &name, int lyr, int rowStart, int rowCount, const double *values) override {
+        lock_guard<mutex> lock(m_mutex);
+        size_t offset = 0;
+        size_t n = 0;
+        auto it = m_rasters.find(name);
+        if (it == m_rasters.end() || !_window_range(it->second, lyr, rowStart, rowCount, offset, n)) return false;
+        if (nullptr != it->second.handle) _materialize(it->second);
+        memcpy(&it->second.values[offset], values, n * sizeof(double));
+        return true;
+    }
+
+    //! Remove a raster, return false if not existed
+    bool remove(const string &name) {
+        lock_guard<mutex> lock(m_mutex);
+        return m_rasters.erase(name) > 0;
+    }
+
+private:
+    //! Raster in memory, values are stored layer by layer, unless the handle is attached
+    struct MemoryRaster {
+        map<string, double> header;
+        string srs;
+        vector<double> values;
+        shared_ptr<const RasterHandle> handle;
+    };
+
+    static bool _window_range(const MemoryRaster &raster, int lyr, int rowStart, int rowCount,
+                              size_t &offset, size_t &n) {
+        if (!_valid_raster_window(raster.header, lyr, rowStart, rowCount)) return false;
+        size_t nRows = (size_t) raster.header.at(HEADER_RS_NROWS);
+        size_t nCols = (size_t) raster.header.at(HEADER_RS_NCOLS);
+        offset = ((lyr - 1) * nRows + rowStart) * nCols;
+        n = rowCount * nCols;
+        return true;
+    }
+
+    //! Convert the attached handle to double values layer by layer, and then release the handle
+    static void _materialize(MemoryRaster &raster) {
+        int nRows = (int) raster.header.at(HEADER_RS_NROWS);
+        int nLyrs = (int) raster.header.at(HEADER_RS_LAYERS);
+        size_t lyrsize = (size_t) nRows * (size_t) raster.header.at(HEADER_RS_NCOLS);
+        raster.values.resize(lyrsize * nLyrs);
+        for (int lyr = 1; lyr <= nLyrs; lyr++) {
+            raster.handle->readWindow(lyr, 0, nRows, &raster.values[(lyr - 1) * lyrsize]);
+        }
+        raster.handle.reset();
+    }
+
+    map<string, MemoryRaster> m_rasters;  ///< Rasters by name
+    mutex m_mutex;                        ///< Lock of rasters
+};
+
+/*!
+ * \class clsRasterStorageASC
+ * \ingroup data
+ * \brief ASC file storage backend. The raster name is the file path, and the layers of 2D raster are
+ *        stored as independent files named <core name>_<layer>.asc, the same as clsRasterData::outputASCFile.
+ *        A lone <core name>_1.asc is a raster of one layer.
+ *
+ *        Since ASC text can neither be read from a row nor updated in place, each layer is parsed once
+ *        and cached as double values (nRows * nCols * 8 bytes per layer) until release(), so the windows
+ *        are read from memory, and writeWindow updates the cache and rewrites the whole layer file.
+ *        The files must not be modified by others while they are cached.
+ *        It is safe to be used by several threads concurrently.
+ */
+class clsRasterStorageASC : public clsRasterStorage {
+public:
+    bool open(const string &name, map<string, double> &header, string &srs) override {
+        vector<string> files = _layer_files(name);
+        if (files.empty()) return false;
+        ifstream ifs(files[0].c_str());
+        if (!ifs.is_open() || !_read_asc_headers(ifs, header)) return false;
+        header[HEADER_RS_LAYERS] = (double) files.size();
+        header[HEADER_RS_CELLSNUM] = -1.;
+        srs = "";
+        return true;
+    }
+
+    bool create(const string &name, const map<string, double> &header, const string &) override {
+        int nLyrs = (int) header.at(HEADER_RS_LAYERS);
+        lock_guard<mutex> lock(m_mutex);
+        m_rasters.erase(name);
+        if (nLyrs > 1) DeleteExistedFile(name);
+        vector<double> values((size_t) header.at(HEADER_RS_NROWS) * (size_t) header.at(HEADER_RS_NCOLS),
+                              header.at(HEADER_RS_NODATA));
+        for (int lyr = 1; lyr <= nLyrs; lyr++) {
+            if (!_write_layer(layerFileName(name, lyr, nLyrs), header, values)) return false;
+        }
+        return true;
+    }
+
+    bool readWindow(const string &name, int lyr, int rowStart, int rowCount, double *values) override {
+        lock_guard<mutex> lock(m_mutex);
+        AscRaster *raster = _load_raster(name);
+        if (nullptr == raster || !_valid_raster_window(raster->header, lyr, rowStart, rowCount) ||
+            !_load_layer(*raster, lyr)) {
+            return false;
+        }
+        size_t nCols = (size_t) raster->header.at(HEADER_RS_NCOLS);
+        memcpy(values, &raster->layers[lyr - 1][rowStart * nCols], rowCount * nCols * sizeof(double));
+        return true;
+    }
+
+    bool writeWindow(const string &name, int lyr, int rowStart, int rowCount, const double *values) override {
+        lock_guard<mutex> lock(m_mutex);
+        AscRaster *raster = _load_raster(name);
+        if (nullptr == raster || !_valid_raster_window(raster->header, lyr, rowStart, rowCount)) return false;
+        int nRows = (int) raster->header.at(HEADER_RS_NROWS);
+        size_t nCols = (size_t) raster->header.at(HEADER_RS_NCOLS);
+        vector<double> &lyrvalues = raster->layers[lyr - 1];
+        /// read-modify-write, unless the window covers the whole layer
+        if (rowCount < nRows && !_load_layer(*raster, lyr)) return false;
+        lyrvalues.resize(nRows * nCols);
+        memcpy(&lyrvalues[rowStart * nCols], values, rowCount * nCols * sizeof(double));
+        return _write_layer(raster->files[lyr - 1], raster->header, lyrvalues);
+    }
+
+    //! Release the cached layers of a raster, return false if not cached
+    bool release(const string &name) {
+        lock_guard<mutex> lock(m_mutex);
+        return m_rasters.erase(name) > 0;
+    }
+
+    //! File name of layer, starts from 1
+    static string layerFileName(const string &name, int lyr, int nLyrs) {
+        if (nLyrs <= 1) return name;
+        stringstream oss;
+        oss << GetPathFromFullName(name) << GetCoreFileName(name) << "_" << lyr << "." << ASCIIExtension;
+        return oss.str();
+    }
+
+private:
+    //! Layer files and the parsed layers of raster, the layer is empty until parsed
+    struct AscRaster {
+        map<string, double> header;
+        vector<string> files;
+        vector<vector<double> > layers;
+    };
+
+    //! Existed layer files of raster, i.e., the file itself or <core name>_1.asc, <core name>_2.asc, ...
+    static vector<string> _layer_files(const string &name) {
+        vector<string> files;
+        if (FileExists(name)) {
+            files.push_back(name);
+            return files;
+        }
+        while (FileExists(layerFileName(name, (int) files.size() + 1, 2))) {
+            files.push_back(layerFileName(name, (int) files.size() + 1, 2));
+        }
+        return files;
+    }
+
+    //! Get the cached raster, or open it with empty layers, nullptr if failed
+    AscRaster *_load_raster(const string &name) {
+        auto it = m_rasters.find(name);
+        if (it != m_rasters.end()) return &it->second;
+        AscRaster raster;
+        string srs;
+        if (!open(name, raster.header, srs)) return nullptr;
+        raster.files = _layer_files(name);
+        raster.layers.resize(raster.files.size());
+        return &(m_rasters[name] = raster);
+    }
+
+    //! Parse the layer (starts from 1) if not cached
+    static bool _load_layer(AscRaster &raster, int lyr) {
+        vector<double> &values = raster.layers[lyr - 1];
+        if (!values.empty()) return true;
+        ifstream ifs(raster.files[lyr - 1].c_str());
+        map<string, double> lyrheader;
+        if (!ifs.is_open() || !_read_asc_headers(ifs, lyrheader)) return false;
+        values.resize((size_t) raster.header.at(HEADER_RS_NROWS) * (size_t) raster.header.at(HEADER_RS_NCOLS));
+        for (size_t i = 0; i < values.size(); i++) ifs >> values[i];
+        if (ifs.fail()) {
+            vector<double>().swap(values);
+            return false;
+        }
+        return true;
+    }
+
+    static bool _write_layer(const string &filename, const map<string, double> &header,
+                             const vector<double> &values) {
+        if (!_write_asc_headers(filename, header)) return false;
+        ofstream rasterFile(filename.c_str(), ios::app | ios::out);
+        if (!rasterFile.is_open()) return false;
+        int nRows = (int) header.at(HEADER_RS_NROWS);
+        int nCols = (int) header.at(HEADER_RS_NCOLS);
+        string row;
+        char buf[32];
+        for (int i = 0; i < nRows; i++) {
+            row.clear();
+            for (int j = 0; j < nCols; j++) {
+                int len = _format_float_g6(values[(size_t) i * nCols + j], buf);
+                buf[len++] = ' ';
+                row.append(buf, len);
+            }
+            row.push_back('\n');
+            rasterFile.write(row.c_str(), row.size());
+        }
+        bool flag = !rasterFile.fail();
+        rasterFile.close();
+        return flag;
+    }
+
+    map<string, AscRaster> m_rasters;  ///< Cached rasters by name
+    mutex m_mutex;                     ///< Lock of cached rasters
+};
+
 /*!
- * Define Raster related constant strings used for raster headers
+ * \class clsRasterStorageGDAL
+ * \ingroup data
+ * \brief Storage backend of raster files supported by GDAL, the layers are bands of one file.
+ *        Rasters are created as GeoTIFF of float, the same as clsRasterData::outputFileByGDAL.
  */
-#define HEADER_RS_NODATA        "NODATA_VALUE"
-#define HEADER_RS_XLL           "XLLCENTER"  /// or XLLCORNER
-#define HEADER_RS_YLL           "YLLCENTER"  /// or YLLCORNER
-#define HEADER_RS_NROWS         "NROWS"
-#define HEADER_RS_NCOLS         "NCOLS"
-#define HEADER_RS_CELLSIZE      "CELLSIZE"
-#define HEADER_RS_LAYERS        "LAYERS"
-#define HEADER_RS_CELLSNUM      "CELLSNUM"
-#define HEADER_RS_SRS           "SRS"
+class clsRasterStorageGDAL : public clsRasterStorage {
+public:
+    bool open(const string &name, map<string, double> &header, string &srs) override {
+        GDALDataset *poDataset = (GDALDataset *) GDALOpen(name.c_str(), GA_ReadOnly);
+        if (nullptr == poDataset) return false;
+        GDALRasterBand *poBand = poDataset->GetRasterBand(1);
+        if (nullptr == poBand) {  /// no band
+            GDALClose(poDataset);
+            return false;
+        }
+        int nRows = poBand->GetYSize();
+        int hasNoData = 0;
+        double nodata = poBand->GetNoDataValue(&hasNoData);
+        double geoTrans[6];
+        poDataset->GetGeoTransform(geoTrans);
+        header[HEADER_RS_NCOLS] = poBand->GetXSize();
+        header[HEADER_RS_NROWS] = nRows;
+        header[HEADER_RS_NODATA] = hasNoData ? nodata : NODATA_VALUE;
+        _geotransform_to_header(geoTrans, nRows, header);
+        header[HEADER_RS_LAYERS] = poDataset->GetRasterCount();
+        header[HEADER_RS_CELLSNUM] = -1.;
+        srs = string(poDataset->GetProjectionRef());
+        GDALClose(poDataset);
+        return true;
+    }
+
+    bool create(const string &name, const map<string, double> &header, const string &srs) override {
+        GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName("GTiff");
+        if (nullptr == poDriver) return false;
+        int nRows = int(header.at(HEADER_RS_NROWS));
+        int nCols = int(header.at(HEADER_RS_NCOLS));
+        int nLyrs = int(header.at(HEADER_RS_LAYERS));
+        GDALDataset *poDstDS = poDriver->Create(name.c_str(), nCols, nRows, nLyrs, GDT_Float32, nullptr);
+        if (nullptr == poDstDS) return false;
+        for (int lyr = 1; lyr <= nLyrs; lyr++) {
+            GDALRasterBand *poDstBand = poDstDS->GetRasterBand(lyr);
+            poDstBand->SetNoDataValue(header.at(HEADER_RS_NODATA));
+            poDstBand->Fill(header.at(HEADER_RS_NODATA));
+        }
+        double geoTrans[6];
+        _header_to_geotransform(header, geoTrans);
+        poDstDS->SetGeoTransform(geoTrans);
+        poDstDS->SetProjection(srs.c_str());
+        GDALClose(poDstDS);
+        return true;
+    }
+
+    bool readWindow(const string &name, int lyr, int rowStart, int rowCount, double *values) override {
+        return _raster_io(name, GF_Read, lyr, rowStart, rowCount, values);
+    }
+
+    bool writeWindow(const string &name, int lyr, int rowStart, int rowCount, const double *values) override {
+        return _raster_io(name, GF_Write, lyr, rowStart, rowCount, const_cast<double *>(values));
+    }
+
+private:
+    static bool _raster_io(const string &name, GDALRWFlag flag, int lyr, int rowStart, int rowCount,
+                           double *values) {
+        GDALDataset *poDataset = (GDALDataset *) GDALOpen(name.c_str(), flag == GF_Read ? GA_ReadOnly : GA_Update);
+        if (nullptr == poDataset) return false;
+        bool done = false;
+        if (lyr >= 1 && lyr <= poDataset->GetRasterCount()) {
+            GDALRasterBand *poBand = poDataset->GetRasterBand(lyr);
+            int nCols = poBand->GetXSize();
+            done = rowStart >= 0 && rowCount > 0 && rowStart + rowCount <= poBand->GetYSize() &&
+                poBand->RasterIO(flag, 0, rowStart, nCols, rowCount, values, nCols, rowCount,
+                                 GDT_Float64, 0, 0) == CE_None;
+        }
+        GDALClose(poDataset);
+        return done;
+    }
+};
+
+#ifdef USE_MONGODB
 
 /*!
- * Define constant strings of statistics index
+ * \class clsRasterStorageGridFS
+ * \ingroup data
+ * \brief GridFS storage backend, the payload is the same as clsRasterData::outputToMongoDB.
+ *        Only the chunks (or compressed blocks) covering the window are fetched by readWindow.
+ *        Since GridFS files can not be updated in place, writeWindow re-uploads the whole payload
+ *        (uncompressed if the rewritten payload was compressed), so prefer to write whole layers.
  */
-#define STATS_RS_VALIDNUM        "VALID_CELLNUMBER"
-#define STATS_RS_MEAN            "MEAN"
-#define STATS_RS_MIN             "MIN"
-#define STATS_RS_MAX             "MAX"
-#define STATS_RS_STD             "STD"
-#define STATS_RS_RANGE           "RANGE"
+class clsRasterStorageGridFS : public clsRasterStorage {
+public:
+    /*!
+     * \brief Constructor
+     * \param[in] gfs \a MongoGridFS
+     * \param[in] dtype Data type of the rasters created by this backend
+     */
+    explicit clsRasterStorageGridFS(MongoGridFS *gfs, RasterDataType dtype = RDT_Float) :
+        m_gfs(gfs), m_dataType(dtype) {}
+
+    bool open(const string &name, map<string, double> &header, string &srs) override {
+        bson_t *bmeta = m_gfs->getFileMetadata(name);
+        if (nullptr == bmeta) return false;
+        GridFSRasterPayload payload;
+        _parse_gridfs_metadata(bmeta, header, srs, payload);
+        bson_destroy(bmeta);
+        return true;
+    }
+
+    bool create(const string &name, const map<string, double> &header, const string &srs) override {
+        int esize = _get_raster_data_type_size(m_dataType);
+        if (esize == 0) return false;
+        size_t n = (size_t) header.at(HEADER_RS_NROWS) * (size_t) header.at(HEADER_RS_NCOLS) *
+            (size_t) header.at(HEADER_RS_LAYERS);
+        vector<double> values(n, header.at(HEADER_RS_NODATA));
+        vector<char> buf(n * esize);
+        if (n > 0) _convert_to_raster_data(&values[0], (int) n, m_dataType, &buf[0]);
+        map<string, double> gfsheader = header;
+        gfsheader[HEADER_RS_CELLSNUM] = -1.;
+        /// band interleaved, so the layers are read and written separately
+        _write_gridfs_payload(m_gfs, name, gfsheader, srs, m_dataType, GridFSLayoutBand,
+                              n > 0 ? &buf[0] : nullptr, buf.size(), RCP_None, GridFSBlockSize);
+        return true;
+    }
+
+    bool readWindow(const string &name, int lyr, int rowStart, int rowCount, double *values) override {
+        vector<int> layers(1, lyr);
+        map<string, double> header;
+        string srs;
+        GridFSRasterPayload payload;
+        char *buf = nullptr;
+        if (!_read_gridfs_window(m_gfs, name, rowStart, rowCount, layers, header, srs, payload, buf)) return false;
+        _convert_raster_data(buf, payload.dataType, rowCount * (int) header.at(HEADER_RS_NCOLS), values);
+        delete[] buf;
+        return true;
+    }
+
+    bool writeWindow(const string &name, int lyr, int rowStart, int rowCount, const double *values) override {
+        /// 1. Read and decode the whole payload
+        bson_t *bmeta = m_gfs->getFileMetadata(name);
+        if (nullptr == bmeta) return false;
+        map<string, double> header;
+        string srs;
+        GridFSRasterPayload payload;
+        _parse_gridfs_metadata(bmeta, header, srs, payload);
+        bson_destroy(bmeta);
+        int esize = _get_raster_data_type_size(payload.dataType);
+        if (StringMatch(payload.layout, GridFSLayoutCompact) || esize == 0 ||
+            !_valid_raster_window(header, lyr, rowStart, rowCount)) {
+            return false;
+        }
+        size_t nCols = (size_t) header.at(HEADER_RS_NCOLS);
+        size_t nCells = (size_t) header.at(HEADER_RS_NROWS) * nCols;
+        size_t nLyrs = (size_t) header.at(HEADER_RS_LAYERS);
+        char *buf = nullptr;
+        size_t length = 0;
+        m_gfs->getStreamData(name, buf, length);
+        if (nullptr == buf) return false;
+        if (!payload.compressionKnown || payload.compression != RCP_None) {
+            char *rawbuf = payload.compressionKnown && payload.rawLength > 0 ? new char[payload.rawLength] : nullptr;
+            bool decoded = nullptr != rawbuf && _decompress_blocks(payload.compression, buf, length,
+                                                                   payload.blockSize, payload.rawLength, rawbuf);
+            delete[] buf;
+            buf = rawbuf;
+            length = payload.rawLength;
+            if (!decoded) {
+                if (nullptr != buf) delete[] buf;
+                return false;
+            }
+        }
+        if (length != nCells * nLyrs * esize) {
+            delete[] buf;
+            return false;
+        }
+        /// 2. Convert the window to the stored type and update the payload
+        size_t n = (size_t) rowCount * nCols;
+        vector<char> window(n * esize);
+        _convert_to_raster_data(values, (int) n, payload.dataType, &window[0]);
+        bool band = StringMatch(payload.layout, GridFSLayoutBand);
+        for (size_t i = 0; i < n; i++) {
+            size_t idx = (size_t) rowStart * nCols + i;
+            size_t offset = band ? (lyr - 1) * nCells + idx : idx * nLyrs + lyr - 1;
+            memcpy(buf + offset * esize, &window[i * esize], esize);
+        }
+        /// 3. Re-upload the payload uncompressed
+        _write_gridfs_payload(m_gfs, name, header, srs, payload.dataType, payload.layout,
+                              buf, length, RCP_None, GridFSBlockSize);
+        delete[] buf;
+        return true;
+    }
+
+private:
+    MongoGridFS *m_gfs;             ///< GridFS, the instance is not thread-safe
+    RasterDataType m_dataType;      ///< Data type of created rasters
+};
+
+#endif /* USE_MONGODB */
 
 /*!
- * Files or database constant strings
+ * \class clsRasterOutputQueue
+ * \ingroup data
+ * \brief Bounded pool of background writers for the asynchronous output of raster data.
+ *
+ *        Each submitted task owns a snapshot of the raster, so the caller can go on
+ *        modifying the raster (e.g., computing timestep t+1) while timestep t is being written.
+ *        If \a capacity tasks are pending, submit() blocks until one writer becomes available.
+ * \usage
+ *        clsRasterOutputQueue *queue = new clsRasterOutputQueue(2);  // each writer uses half of the OpenMP threads
+ *        shared_future<bool> done = rs->outputToFileAsync(queue, "/path/to/out.tif");
+ *        ... // go on computing
+ *        queue->flush();  // barrier, or done.get() to wait for the given output only
  */
-#define ASCIIExtension          "asc"
-#define GTiffExtension          "tif"
+class clsRasterOutputQueue {
+public:
+    /*!
+     * \brief Constructor
+     * \param[in] nWriters Number of background writer threads, at least 1
+     * \param[in] capacity Maximum number of pending (not yet started) tasks, at least 1
+     * \param[in] nThreads Number of OpenMP threads of each writer, 0 means sharing the threads
+     *                     of the caller, i.e., omp_get_max_threads() / nWriters, at least 1
+     */
+    explicit clsRasterOutputQueue(int nWriters = 1, int capacity = 4, int nThreads = 0) :
+        m_capacity(capacity > 0 ? capacity : 1), m_nThreads(nThreads), m_unfinished(0), m_stop(false) {
+        if (nWriters < 1) nWriters = 1;
+        if (m_nThreads < 1) {
+#ifdef SUPPORT_OMP
+            m_nThreads = omp_get_max_threads() / nWriters;
+#endif /* SUPPORT_OMP */
+            if (m_nThreads < 1) m_nThreads = 1;
+        }
+        for (int i = 0; i < nWriters; i++) {
+            m_writers.push_back(thread(&clsRasterOutputQueue::_writer_loop, this));
+        }
+    }
 
-typedef pair<int, int> RowCol;
-typedef pair<double, double> XYCoor;
+    //! Destructor, all submitted tasks are finished before return
+    ~clsRasterOutputQueue() {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_notEmpty.notify_all();
+        for (auto it = m_writers.begin(); it != m_writers.end(); ++it) {
+            if (it->joinable()) it->join();
+        }
+    }
 
-/** Common functions independent to clsRasterData **/
-inline void print_status(string status_str) {
-#ifndef UNITTEST
-    cout << status_str << endl;
-#endif
-}
+    /*!
+     * \brief Submit an output task, block if the queue is full
+     * \return Completion handle, get() returns the result of \a task
+     */
+    shared_future<bool> submit(function<bool()> task) {
+        packaged_task<bool()> ptask(task);
+        shared_future<bool> result = ptask.get_future().share();
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_notFull.wait(lock, [this] { return m_tasks.size() < m_capacity; });
+            m_tasks.push_back(std::move(ptask));
+            m_unfinished++;
+        }
+        m_notEmpty.notify_one();
+        return result;
+    }
+
+    //! Barrier, wait until all the submitted tasks have been finished
+    void flush() {
+        unique_lock<mutex> lock(m_mutex);
+        m_allDone.wait(lock, [this] { return m_unfinished == 0; });
+    }
+
+    //! Get number of background writers
+    int getWriterNumber() const { return (int) m_writers.size(); }
+
+    //! Get number of OpenMP threads of each writer
+    int getThreadNumber() const { return m_nThreads; }
+
+private:
+    //! Loop of background writer, exit when stopped and no pending task left
+    void _writer_loop() {
+#ifdef SUPPORT_OMP
+        /// the tasks run parallel regions (e.g., outputASCFile), which would otherwise
+        /// start omp_get_max_threads() threads per writer besides the computing threads
+        omp_set_num_threads(m_nThreads);
+#endif /* SUPPORT_OMP */
+        while (true) {
+            packaged_task<bool()> ptask;
+            {
+                unique_lock<mutex> lock(m_mutex);
+                m_notEmpty.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty()) return;
+                ptask = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            m_notFull.notify_one();
+            ptask();  // exceptions are stored in the shared future
+            {
+                unique_lock<mutex> lock(m_mutex);
+                m_unfinished--;
+                if (m_unfinished == 0) m_allDone.notify_all();
+            }
+        }
+    }
+
+    //! Copy is not allowed
+    clsRasterOutputQueue(const clsRasterOutputQueue &);
+
+    clsRasterOutputQueue &operator=(const clsRasterOutputQueue &);
+
+private:
+    ///< pending tasks
+    deque<packaged_task<bool()> > m_tasks;
+    ///< background writers
+    vector<thread> m_writers;
+    ///< maximum number of pending tasks
+    size_t m_capacity;
+    ///< number of OpenMP threads of each writer
+    int m_nThreads;
+    ///< submitted but not finished tasks, including the pending and running ones
+    int m_unfinished;
+    ///< stop flag, set by destructor
+    bool m_stop;
+    mutex m_mutex;
+    condition_variable m_notEmpty;
+    condition_variable m_notFull;
+    condition_variable m_allDone;
+};
 
 /*!
- * \brief check the existence of given raster file
+ * \class clsRasterSpanIndex
+ * \ingroup data
+ * \brief Run-length (row-span) index of the valid cells of a compacted raster, \sa clsRasterData::getSpanIndex
+ *
+ *        Valid cells are indexed row by row as spans of consecutive columns. Each span records
+ *        its start column and the compact index of its first cell, so the memory is O(spans)
+ *        rather than O(valid cells). The spans of one row are located by the row offsets, and the
+ *        span containing a column is found by binary search. Iterating over the spans of all rows
+ *        visits valid cells in the order of their compact indexes.
+ * \usage
+ *        for (int row = 0; row < idx->getRows(); row++) {
+ *            for (int s = idx->getRowSpanBegin(row); s < idx->getRowSpanEnd(row); s++) {
+ *                // cells (row, getSpanColumn(s) + k), compact index getSpanStart(s) + k,
+ *                // k = 0 ~ getSpanLength(s) - 1
+ *            }
+ *        }
  */
-inline bool _check_raster_files_exist(const string &filename) {
-    if (!FileExists(filename)) {
-        print_status("The raster file " + filename + " does not exist or has not read permission.");
-        return false;
+class clsRasterSpanIndex {
+public:
+    clsRasterSpanIndex() : m_nRows(0), m_nCells(0) {}
+
+    /*!
+     * \brief Build the index from position data
+     * \param[in] nRows Row number of the raster
+     * \param[in] nCells Valid cell number
+     * \param[in] positions (row, col) of valid cells, sorted row by row and column by column
+     * \return false if \a positions are not sorted or out of range, and the index is empty
+     */
+    bool build(int nRows, int nCells, const int *const *positions) {
+        m_nRows = nRows > 0 ? nRows : 0;
+        m_nCells = 0;
+        m_rowOffsets.assign(m_nRows + 1, 0);
+        m_spanCols.clear();
+        m_spanStarts.clear();
+        int lastrow = -1;
+        int lastcol = -1;
+        for (int i = 0; i < nCells; i++) {
+            int row = positions[i][0];
+            int col = positions[i][1];
+            if (row < lastrow || row >= m_nRows || col < 0 || (row == lastrow && col <= lastcol)) {
+                this->clear();
+                return false;
+            }
+            if (row != lastrow || col != lastcol + 1) {  // start a new span
+                m_spanCols.push_back(col);
+                m_spanStarts.push_back(i);
+                m_rowOffsets[row + 1]++;
+            }
+            lastrow = row;
+            lastcol = col;
+        }
+        for (int row = 0; row < m_nRows; row++) {
+            m_rowOffsets[row + 1] += m_rowOffsets[row];
+        }
+        m_spanStarts.push_back(nCells);  // sentinel, the end of the last span
+        vector<int>(m_spanCols).swap(m_spanCols);
+        vector<int>(m_spanStarts).swap(m_spanStarts);
+        m_nCells = nCells;
+        return true;
     }
-    return true;
-}
+
+    //! Clear the index
+    void clear() {
+        m_nRows = 0;
+        m_nCells = 0;
+        m_rowOffsets.assign(1, 0);
+        m_spanCols.clear();
+        m_spanStarts.assign(1, 0);
+    }
+
+    /*!
+     * \brief Find the compact index of the cell, O(log(spans in the row))
+     * \return -1 if the cell is not valid or out of range
+     */
+    int find(int row, int col) const {
+        if (row < 0 || row >= m_nRows) return -1;
+        const int *first = m_spanCols.empty() ? nullptr : &m_spanCols[0];
+        const int *begin = first + m_rowOffsets[row];
+        const int *end = first + m_rowOffsets[row + 1];
+        const int *it = std::upper_bound(begin, end, col);  // the first span starts after col
+        if (it == begin) return -1;
+        int s = (int) (it - first) - 1;
+        int offset = col - m_spanCols[s];
+        return offset < this->getSpanLength(s) ? m_spanStarts[s] + offset : -1;
+    }
+
+    /*!
+     * \brief Get the position of the given compact index, O(log(spans))
+     * \return false if \a index is out of range
+     */
+    bool getCellPosition(int index, int *row, int *col) const {
+        if (index < 0 || index >= m_nCells) return false;
+        int s = (int) (std::upper_bound(m_spanStarts.begin(), m_spanStarts.end(), index) -
+                       m_spanStarts.begin()) - 1;
+        *row = (int) (std::upper_bound(m_rowOffsets.begin(), m_rowOffsets.end(), s) -
+                      m_rowOffsets.begin()) - 1;
+        *col = m_spanCols[s] + index - m_spanStarts[s];
+        return true;
+    }
+
+    //! Row number
+    int getRows() const { return m_nRows; }
+
+    //! Valid cell number
+    int getCellNumber() const { return m_nCells; }
+
+    //! Span number
+    int getSpanNumber() const { return (int) m_spanCols.size(); }
+
+    //! The first span of the given row
+    int getRowSpanBegin(int row) const { return m_rowOffsets[row]; }
+
+    //! One past the last span of the given row
+    int getRowSpanEnd(int row) const { return m_rowOffsets[row + 1]; }
+
+    //! Start column of the given span
+    int getSpanColumn(int s) const { return m_spanCols[s]; }
+
+    //! Compact index of the first cell of the given span
+    int getSpanStart(int s) const { return m_spanStarts[s]; }
+
+    //! Cell number of the given span
+    int getSpanLength(int s) const { return m_spanStarts[s + 1] - m_spanStarts[s]; }
+
+private:
+    ///< row number
+    int m_nRows;
+    ///< valid cell number
+    int m_nCells;
+    ///< spans of row r are [m_rowOffsets[r], m_rowOffsets[r + 1]), nRows + 1 elements
+    vector<int> m_rowOffsets;
+    ///< start column of each span
+    vector<int> m_spanCols;
+    ///< compact index of the first cell of each span, and the cell number as the last element
+    vector<int> m_spanStarts;
+};
 
 /*!
- * \brief check the existence of given vector of raster files
- * \return True if all existed, else false
+ * \class clsRasterPositionIndex
+ * \ingroup data
+ * \brief Positions of the valid cells of a compacted raster, shared by reference counting,
+ *        \sa clsRasterData::getPositionIndex
+ *
+ *        The index is immutable once created. Rasters derived from one mask and copies of a raster
+ *        hold the same index through shared_ptr, so the positions and the row-span index are
+ *        stored once and released together with the last holder.
  */
-inline bool _check_raster_files_exist(vector<string> &filenames) {
-    for (auto it = filenames.begin(); it != filenames.end(); it++) {
-        if (!_check_raster_files_exist(*it)) {
-            return false;
+class clsRasterPositionIndex {
+public:
+    /*!
+     * \brief Adopt position data
+     * \param[in] nRows Row number of the raster
+     * \param[in] nCells Valid cell number
+     * \param[in] positions (row, col) of valid cells allocated by _initialize_2d_buffer(nCells, 2, ...),
+     *                      which is released by the index
+     */
+    clsRasterPositionIndex(int nRows, int nCells, int **positions) :
+        m_nRows(nRows), m_nCells(nCells), m_positions(positions), m_spanIndex(nullptr), m_spanFailed(false) {}
+
+    ~clsRasterPositionIndex() {
+        _release_2d_buffer(m_positions);
+        delete m_spanIndex.load();
+    }
+
+    //! Row number
+    int getRows() const { return m_nRows; }
+
+    //! Valid cell number
+    int getCellNumber() const { return m_nCells; }
+
+    //! Row pointers of the packed (row, col) pairs, which MUST NOT be modified
+    int **getPositions() const { return m_positions; }
+
+    //! Is the same as the given position data?
+    bool equals(int nCells, const int *const *positions) const {
+        if (nCells != m_nCells || nullptr == positions) return false;
+        for (int i = 0; i < nCells; i++) {
+            if (m_positions[i][0] != positions[i][0] || m_positions[i][1] != positions[i][1]) return false;
         }
+        return true;
     }
-    return true;
-}
 
-template<typename T1, typename T2>
-inline void _get_data_from_gdal(T1 *dst, T2 *src, int nr, int nc) {
-#pragma omp parallel for
-    for (int i = 0; i < nr; ++i) {
-        for (int j = 0; j < nc; ++j) {
-            int index = i * nc + j;
-            dst[index] = (T1) src[index];
+    /*!
+     * \brief Get the row-span index, which is built on the first call. Thread-safe.
+     *        A failed build is remembered, so it is neither retried nor reported again.
+     * \return nullptr if the positions are not sorted row by row
+     */
+    const clsRasterSpanIndex *getSpanIndex() const {
+        clsRasterSpanIndex *spans = m_spanIndex.load();
+        if (nullptr != spans || m_spanFailed.load()) return spans;
+        lock_guard<mutex> lock(m_spanMutex);
+        spans = m_spanIndex.load();
+        if (nullptr != spans || m_spanFailed.load()) return spans;
+        spans = new clsRasterSpanIndex();
+        if (!spans->build(m_nRows, m_nCells, m_positions)) {
+            print_status("Position data is not sorted row by row, the span index is not available!");
+            delete spans;
+            m_spanFailed.store(true);
+            return nullptr;
         }
+        m_spanIndex.store(spans);
+        return spans;
     }
-}
+
+private:
+    clsRasterPositionIndex(const clsRasterPositionIndex &);
+
+    clsRasterPositionIndex &operator=(const clsRasterPositionIndex &);
+
+private:
+    ///< row number
+    int m_nRows;
+    ///< valid cell number
+    int m_nCells;
+    ///< row pointers of one packed buffer of (row, col) pairs
+    int **m_positions;
+    ///< row-span index, built lazily
+    mutable atomic<clsRasterSpanIndex *> m_spanIndex;
+    ///< building m_spanIndex has failed, which is not retried
+    mutable atomic<bool> m_spanFailed;
+    ///< guard of building m_spanIndex
+    mutable mutex m_spanMutex;
+};
+
 /*!
  * \class clsRasterData
  * \ingroup data
@@ -257,6 +2585,35 @@ public:
                                          bool useMaskExtent = true,
                                          T defalutValue = (T) NODATA_VALUE);
 
+    /*!
+     * \brief Load rasters from MongoDB in parallel, \sa ReadFromMongoDB.
+     *        Each worker thread pops a client from \a pool and reads the remaining rasters one by one,
+     *        so the network transfer of one raster is overlapped with the decoding and
+     *        compaction of others. The OpenMP threads of each worker are omp_get_max_threads() / nThreads.
+     * \usage
+     *        mongoc_client_pool_t *pool = mongoc_client_pool_new(uri);
+     *        vector<clsRasterData<float, int> *> rasters =
+     *            clsRasterData<float, int>::BatchInit(pool, "model", "spatial", names, true, mask);
+     * \param[in] pool \a mongoc_client_pool_t, the maximum size should be no less than \a nThreads
+     * \param[in] dbname Database name
+     * \param[in] gfsname GridFS prefix
+     * \param[in] remoteFilenames Raster file names
+     * \param[in] calcPositions Calculate positions of valid cells excluding NODATA. The default is true.
+     * \param[in] mask \a clsRasterData<MaskT> Mask layer shared by all rasters
+     * \param[in] useMaskExtent Use mask layer extent, even NoDATA exists.
+     * \param[in] nThreads Number of worker threads, 0 means the number of hardware threads
+     * \return Rasters in the same order as \a remoteFilenames, nullptr if failed
+     */
+    static vector<clsRasterData<T, MaskT> *> BatchInit(mongoc_client_pool_t *pool,
+                                                       const string &dbname,
+                                                       const string &gfsname,
+                                                       const vector<string> &remoteFilenames,
+                                                       bool calcPositions = true,
+                                                       clsRasterData<MaskT> *mask = nullptr,
+                                                       bool useMaskExtent = true,
+                                                       int nThreads = 0,
+                                                       T defalutValue = (T) NODATA_VALUE);
+
 #endif
 
     /*!
@@ -272,6 +2629,21 @@ public:
      */
     explicit clsRasterData(clsRasterData<T, MaskT> *another);
 
+    /*!
+     * \brief Move constructor, which takes over raster data, position index, statistics, etc.
+     *        without copying. \a another is left as a blank raster, i.e., clsRasterData().
+     * \usage
+     *         vector<clsRasterData<T> > rasters;
+     *         rasters.push_back(clsRasterData<T>(filename));
+     */
+    clsRasterData(clsRasterData<T, MaskT> &&another);
+
+    //! Move assignment, the original data is released and \a another is left as a blank raster
+    clsRasterData &operator=(clsRasterData<T, MaskT> &&another);
+
+    //! Exchange all data with \a another in O(1), which never throws
+    void swap(clsRasterData<T, MaskT> &another) NOEXCEPT;
+
     //! Destructor
     ~clsRasterData();
 
@@ -290,6 +2662,7 @@ public:
 
     /*!
      * \brief Read raster data from MongoDB
+     *        The decoded payload is cached on local disk if enabled, \sa SetGridFSCacheDirectory
      * \param[in] gfs \a mongoc_gridfs_t
      * \param[in] filename \a char*, raster file name
      * \param[in] calcPositions Calculate positions of valid cells excluding NODATA. The default is true.
@@ -303,7 +2676,41 @@ public:
                          bool useMaskExtent = true,
                          T defalutValue = (T) NODATA_VALUE);
 
-#endif /* USE_MONGODB */
+    /*!
+     * \brief Read a window of rows and a subset of layers from MongoDB.
+     *        Only the GridFS chunks (or compressed blocks) covering the window are fetched.
+     *        All layers of the rows are fetched if the layers are pixel interleaved,
+     *        so store the raster band interleaved for reading layers separately, \sa setGridFSBandInterleaved
+     * \param[in] gfs \a MongoGridFS
+     * \param[in] filename \a string, raster file name
+     * \param[in] rowStart First row of the window, starts from 0
+     * \param[in] rowCount Row number of the window
+     * \param[in] layers Layers to read, starts from 1. The default is empty, i.e., all layers.
+     * \param[in] calcPositions Calculate positions of valid cells excluding NODATA. The default is true.
+     * \return false if the raster is stored as the COMPACT layout, or the window is out of extent
+     */
+    bool ReadWindowFromMongoDB(MongoGridFS *gfs,
+                               string filename,
+                               int rowStart,
+                               int rowCount,
+                               vector<int> layers = vector<int>(),
+                               bool calcPositions = true,
+                               T defalutValue = (T) NODATA_VALUE);
+
+#endif /* USE_MONGODB */
+
+    /*!
+     * \brief Read raster data from storage backend, e.g., clsRasterStorageMemory
+     * \param[in] storage \a clsRasterStorage
+     * \param[in] name \a string, raster name in \a storage
+     * \param[in] calcPositions Calculate positions of valid cells excluding NODATA. The default is true.
+     * \param[in] mask \a clsRasterData<MaskT>
+     * \param[in] useMaskExtent Use mask layer extent, even NoDATA exists.
+     */
+    bool ReadFromStorage(clsRasterStorage *storage, string name, bool calcPositions = true,
+                         clsRasterData<MaskT> *mask = nullptr, bool useMaskExtent = true,
+                         T defalutValue = (T) NODATA_VALUE);
+
     /************* Write functions ***************/
 
     /*!
@@ -324,17 +2731,117 @@ public:
      */
     bool outputFileByGDAL(string filename);
 
+    /*!
+     * \brief Write 1D or 2D raster data into Cloud-Optimized GeoTIFF (COG) file(s)
+     *        The overview pyramid is built from the in-memory data in parallel, and then copied
+     *        together with the data into the GeoTIFF in COG layout, i.e., no need of `gdaladdo` afterward.
+     *        Each layer is staged in an in-memory GDAL dataset before copying (GDAL 2.1+), so besides the
+     *        raster data, each concurrently written layer takes about 2.33 times of one float layer, i.e.,
+     *        the float buffer, the staged copy, and the pyramid. Earlier GDAL can not build overviews of
+     *        in-memory dataset, so the layer is staged in a temporary GeoTIFF (`<filename>.stage.tif`).
+     * \param[in] filename \a string, output TIFF file path, if 2D raster, output name will be filename_LyrNum
+     * \param[in] blockSize \a int, tile size (both width and height), must be a multiple of 16
+     */
+    bool outputCOGFile(string filename, int blockSize = 256);
+
 #ifdef USE_MONGODB
 
     /*!
      * \brief Write raster data (matrix raster data) into MongoDB
      * \param[in] filename \a string, output file name
      * \param[in] gfs \a mongoc_gridfs_t
+     * \param[in] compact Store valid cells and the run-length positions only, i.e., LAYOUT is COMPACT.
+     *            The payload is RUNSNUM runs of int32 (row, start column, length), padded to 8 bytes,
+     *            followed by the values of CELLSNUM valid cells (layer is the fastest varying dimension).
+     * The payload is block compressed if set, \sa setGridFSCompression
+     * Layers of 2D raster are stored band interleaved if set, \sa setGridFSBandInterleaved
+     */
+    void outputToMongoDB(string filename, MongoGridFS *gfs, bool compact = false);
+
+#endif /* USE_MONGODB */
+
+    /*!
+     * \brief Write raster data into storage backend layer by layer, the existed raster will be replaced
+     * \param[in] storage \a clsRasterStorage
+     * \param[in] name \a string, raster name in \a storage
+     */
+    bool outputToStorage(clsRasterStorage *storage, string name);
+
+    /*!
+     * \brief Write raster to raster file asynchronously, \sa outputToFile
+     *        A snapshot of the current raster data is handed to the background writers of \a queue,
+     *        so this raster can be modified as soon as this function returns.
+     * \param[in] queue \a clsRasterOutputQueue
+     * \param[in] filename filename with prefix, e.g. ".asc" and ".tif"
+     * \return Completion handle, get() returns the result of outputToFile
+     */
+    shared_future<bool> outputToFileAsync(clsRasterOutputQueue *queue, string filename);
+
+#ifdef USE_MONGODB
+
+    /*!
+     * \brief Write raster data into MongoDB asynchronously, \sa outputToMongoDB
+     *        Since mongoc_client_t is not thread-safe, \a gfs MUST be used by \a queue only
+     *        and \a queue MUST have only one writer.
+     * \param[in] queue \a clsRasterOutputQueue
+     * \param[in] filename \a string, output file name
+     * \param[in] gfs \a MongoGridFS dedicated to \a queue
+     * \return Completion handle, get() returns whether the file exists in GridFS after uploading.
+     *         The existed file with the same name is replaced.
+     */
+    shared_future<bool> outputToMongoDBAsync(clsRasterOutputQueue *queue, string filename, MongoGridFS *gfs,
+                                             bool compact = false);
+
+    /*!
+     * \brief Write rasters into MongoDB in parallel, \sa outputToMongoDB.
+     *        Each worker thread pops a client from \a pool and writes the remaining rasters one by one,
+     *        so the upload of one raster is overlapped with the payload preparation of others.
+     *        The OpenMP threads of each worker are omp_get_max_threads() / nThreads.
+     *        The rasters MUST not be modified until this function returns.
+     * \usage
+     *        mongoc_client_pool_t *pool = mongoc_client_pool_new(uri);
+     *        vector<bool> written = clsRasterData<float, int>::BatchOutputToMongoDB(pool, "model", "spatial",
+     *                                                                              rasters, names);
+     * \param[in] pool \a mongoc_client_pool_t, the maximum size should be no less than \a nThreads
+     * \param[in] dbname Database name
+     * \param[in] gfsname GridFS prefix
+     * \param[in] rasters Rasters to write
+     * \param[in] remoteFilenames Output file names in the same order as \a rasters
+     * \param[in] compact Store valid cells and the run-length positions only, \sa outputToMongoDB
+     * \param[in] nThreads Number of worker threads, 0 means the number of hardware threads
+     * \param[in] onCompleted Called with the index and result of each raster as soon as it is written,
+     *            the calls are serialized, but may come from any worker thread
+     * \return Whether each raster is written, i.e., the file exists in GridFS after uploading.
+     *         The existed files with the same names are replaced.
      */
-    void outputToMongoDB(string filename, MongoGridFS *gfs);
+    static vector<bool> BatchOutputToMongoDB(mongoc_client_pool_t *pool,
+                                             const string &dbname,
+                                             const string &gfsname,
+                                             const vector<clsRasterData<T, MaskT> *> &rasters,
+                                             const vector<string> &remoteFilenames,
+                                             bool compact = false,
+                                             int nThreads = 0,
+                                             function<void(int, bool)> onCompleted = nullptr);
 
 #endif /* USE_MONGODB */
 
+    /*!
+     * \brief Save the complete state of raster into one binary file for checkpoint/restart,
+     *        including headers, SRS, raster data (in the compacted layout), positions of valid cells,
+     *        default value, and cached statistics. Data is stored in native byte order.
+     * \param[in] filename \a string, output binary file path
+     */
+    bool saveState(string filename);
+
+    /*!
+     * \brief Restore the complete state of raster saved by saveState() by bulk reading,
+     *        i.e., no re-masking and no recalculation of positions and statistics.
+     * \param[in] filename \a string, binary file path written by saveState()
+     * \param[in] mask \a clsRasterData<MaskT>, optional. If the positions were borrowed from the mask
+     *            when saving, they will be borrowed from \a mask again if consistent.
+     */
+    bool loadState(string filename, clsRasterData<MaskT> *mask = nullptr);
+
     /************************************************************************/
     /*    Set information functions                                         */
     /************************************************************************/
@@ -342,11 +2849,56 @@ public:
     //! Set new core file name
     void setCoreName(string name) { m_coreFileName = name; }
 
+    /*!
+     * \brief Set the number of threads for writing layers of 2D raster concurrently,
+     *        i.e., outputASCFile() and outputFileByGDAL().
+     * \param[in] n Thread number, 0 or negative means the default number of OpenMP threads.
+     */
+    void setOutputThreadNumber(int n) { m_nOutputThreads = n > 0 ? n : 0; }
+
+    /*!
+     * \brief Set the block compression of payloads written by outputToMongoDB().
+     *        Data is split into blocks of \a blockSize bytes which are compressed and decompressed
+     *        independently in parallel. ReadFromMongoDB() decodes the payload transparently.
+     * \param[in] codec \a RasterCompression, RCP_None to disable
+     * \param[in] blockSize Uncompressed bytes of each block, must be positive
+     * \return false if \a codec is not compiled in, i.e., USE_LZ4 or USE_ZSTD is not defined
+     */
+    bool setGridFSCompression(RasterCompression codec, int blockSize = GridFSBlockSize);
+
+    /*!
+     * \brief Store layers of 2D raster band interleaved (layer-major) by outputToMongoDB(),
+     *        i.e., LAYOUT is BAND, which is efficient for reading one layer, \sa ReadWindowFromMongoDB.
+     *        The default is pixel interleaved, i.e., layer is the fastest varying dimension.
+     */
+    void setGridFSBandInterleaved(bool band) { m_gfsBandInterleaved = band; }
+
     /*!
      * \brief Set value to the given position and layer
      */
     void setValue(int row, int col, T value, int lyr = 1);
 
+    /*!
+     * \brief Enable (or disable) the tracking of modified tiles, which is required by updateFile().
+     *        Once enabled, outputFileByGDAL() writes tiled GeoTIFF with the same tile size.
+     * \param[in] tileSize Tile size (both width and height), must be a multiple of 16. 0 means disable.
+     * \return true if succeed, otherwise return false and print error info.
+     */
+    bool setDirtyTileTracking(int tileSize = 256);
+
+    /*!
+     * \brief Rewrite only the modified (i.e., dirty) tiles of an existing tiled GeoTIFF file(s),
+     *        which is written by outputFileByGDAL() with dirty tile tracking enabled.
+     *        Dirty marks are cleared by outputFileByGDAL() and updateFile(),
+     *        thus the file should be the one written or updated last.
+     *        ASC file is not supported since the text can not be patched in place.
+     * \param[in] filename \a string, TIFF file path, if 2D raster, file names will be filename_LyrNum
+     */
+    bool updateFile(string filename);
+
+    //! Clear all dirty marks
+    void clearDirtyTiles();
+
     /************************************************************************/
     /*    Get information functions                                         */
     /************************************************************************/
@@ -493,16 +3045,18 @@ public:
     T getDefaultValue() const { return m_defaultValue; }
 
     /*!
-     * \brief Get position index in 1D raster data for specific row and column
+     * \brief Get position index in 1D raster data for specific row and column.
+     *        For compacted raster, the index is looked up in the row-span index (\sa getSpanIndex),
+     *        i.e., O(log(spans in the row)) instead of scanning all valid cells.
      * \return -1 --- the position is nodata
      *         -2 --- the position is out of the extent, which indicates an error
      */
     int getPosition(int row, int col);
 
-    //! Get position index in 1D raster data for given coordinate (x,y)
+    //! Get position index in 1D raster data for given coordinate (x,y), \sa getPosition(int, int)
     int getPosition(float x, float y);
 
-    //! Get position index in 1D raster data for given coordinate (x,y)
+    //! Get position index in 1D raster data for given coordinate (x,y), \sa getPosition(int, int)
     int getPosition(double x, double y);
 
     /*! \brief Get raster data, include valid cell number and data
@@ -543,14 +3097,105 @@ public:
     //! Get pointer of position data
     int **getRasterPositionDataPointer() const { return m_rasterPositionData; }
 
-    //! Get pointer of 2D raster data
+    /*!
+     * \brief Get the packed buffer of position data, i.e., m_nCells (row, col) pairs,
+     *        which is the same memory as getRasterPositionDataPointer().
+     * \return nullptr if position data is not calculated
+     */
+    const int *getRasterPositionBuffer() const {
+        return nullptr != m_rasterPositionData ? m_rasterPositionData[0] : nullptr;
+    }
+
+    /*!
+     * \brief Get the shared position index, which holds position data and the row-span index.
+     *        Rasters borrowing position data from the same mask and their copies share one index.
+     * \return nullptr if position data is not calculated
+     */
+    shared_ptr<clsRasterPositionIndex> getPositionIndex() const { return m_positionIndex; }
+
+    /*!
+     * \brief Get the row-span index of valid cells, which is built from position data on the first
+     *        call and kept until position data changes. It is shared together with the position index.
+     *        Thread-safe.
+     * \return nullptr if position data is not calculated
+     */
+    const clsRasterSpanIndex *getSpanIndex() const {
+        return nullptr != m_positionIndex ? m_positionIndex->getSpanIndex() : nullptr;
+    }
+
+    /*!
+     * \brief Get pointer of 2D raster data, indexed by [cellIndex][layer] in RL_CellMajor layout,
+     *        or by [layer][cellIndex] in RL_LayerMajor layout.
+     */
     T **get2DRasterDataPointer() const { return m_raster2DData; }
 
+    /*!
+     * \brief Get the contiguous buffer of 2D raster data, i.e., m_nCells * m_nLyrs values (layer is
+     *        the fastest varying dimension in RL_CellMajor layout, while cell is the fastest
+     *        varying dimension in RL_LayerMajor layout), which is the same memory as get2DRasterDataPointer().
+     *        The buffer is aligned at RasterDataAlignment bytes. Layer planes may be padded,
+     *        see getLayerStride().
+     * \return nullptr if not 2D raster, or the 2D raster data is adopted from the caller
+     */
+    T *get2DRasterDataBuffer() const {
+        return m_is2DRaster && m_contiguous2D && nullptr != m_raster2DData ? m_raster2DData[0] : nullptr;
+    }
+
+    //! Get the memory layout of 2D raster data
+    RasterLayout getRasterLayout() const { return m_layout; }
+
+    /*!
+     * \brief Get the number of elements between the values of two consecutive cells of the same layer,
+     *        i.e., m_nLyrs in RL_CellMajor layout, otherwise 1
+     */
+    int getCellStride() const {
+        return m_is2DRaster && m_layout == RL_CellMajor ? m_nLyrs : 1;
+    }
+
+    /*!
+     * \brief Get the number of elements between the values of the same cell in two consecutive layers,
+     *        i.e., 1 in RL_CellMajor layout, or the (padded) plane length in RL_LayerMajor layout.
+     *        m_nCells for 1D raster data.
+     */
+    int getLayerStride() const {
+        if (!m_is2DRaster) return m_nCells;
+        if (m_layout == RL_CellMajor) return 1;
+        if (nullptr == m_raster2DData || m_nLyrs < 2) return m_nCells;
+        return (int) (m_raster2DData[1] - m_raster2DData[0]);
+    }
+
+    /*!
+     * \brief Get the contiguous plane (m_nCells values) of the given layer of 2D raster data
+     * \param[in] lyr Layer number, starts from 1
+     * \return nullptr if not 2D raster, or not in RL_LayerMajor layout
+     */
+    T *getLayerDataPointer(int lyr) const {
+        if (!m_is2DRaster || m_layout != RL_LayerMajor || nullptr == m_raster2DData) return nullptr;
+        if (lyr < 1 || lyr > m_nLyrs) return nullptr;
+        return m_raster2DData[lyr - 1];
+    }
+
+    /*!
+     * \brief Transpose 2D raster data into the given memory layout.
+     *
+     *        Reading and constructing functions always produce RL_CellMajor data. RL_LayerMajor
+     *        stores each layer as one contiguous plane, which suits per-layer computations,
+     *        e.g., statistics and band-interleaved output. Accessors and output functions honor
+     *        the current layout. Nothing is done for 1D raster data.
+     *        The data is copied into a newly allocated buffer which then replaces the original one,
+     *        i.e., NOT in place, so the peak memory is about twice the size of the 2D raster data.
+     * \param[in] layout Target layout
+     * \param[in] padLayers Pad each layer plane of RL_LayerMajor layout to a multiple of
+     *                      RasterDataAlignment bytes, so that every plane starts aligned
+     * \return true if succeed
+     */
+    bool transposeLayout(RasterLayout layout, bool padLayers = false);
+
     //! Get the spatial reference
-    const char *getSRS() { return m_srs.c_str(); }
+    const char *getSRS() const { return m_srs.c_str(); }
 
     //! Get the spatial reference string
-    string getSRSString() { return m_srs; }
+    string getSRSString() const { return m_srs; }
 
     /*!
      * \brief Get raster data at the valid cell index
@@ -590,7 +3235,7 @@ public:
     //! Calculate positions or not
     bool PositionsCalculated() const { return m_calcPositions; }
 
-    //! raster position data is stored as array (true), or just a pointer
+    //! raster position data is calculated by this raster (true), or shared from the mask
     bool PositionsAllocated() const { return m_storePositions; }
 
     //! Use mask extent or not
@@ -599,6 +3244,33 @@ public:
     //! Basic statistics has been calculated or not
     bool StatisticsCalculated() const { return m_statisticsCalculated; }
 
+    //! Get the number of threads for writing layers concurrently, 0 means the default of OpenMP
+    int getOutputThreadNumber() const { return m_nOutputThreads; }
+
+    //! Get the block compression of payloads written by outputToMongoDB()
+    RasterCompression getGridFSCompression() const { return m_gfsCompression; }
+
+    //! Get the uncompressed bytes of compression blocks
+    int getGridFSBlockSize() const { return m_gfsBlockSize; }
+
+    //! Layers of 2D raster are stored band interleaved into GridFS or not
+    bool GridFSBandInterleaved() const { return m_gfsBandInterleaved; }
+
+    //! Dirty tiles are tracked or not
+    bool DirtyTilesTracked() const { return m_tileSize > 0; }
+
+    //! Get tile size of dirty tile tracking, 0 means not tracked
+    int getTileSize() const { return m_tileSize; }
+
+    //! Get number of dirty tiles of all layers
+    int getDirtyTileNumber() const {
+        int count = 0;
+        for (auto it = m_dirtyTiles.begin(); it != m_dirtyTiles.end(); ++it) {
+            if (*it != 0) count++;
+        }
+        return count;
+    }
+
     //! The instance of clsRasterData has been initialized or not
     bool Initialized() const { return m_initialized; }
 
@@ -654,7 +3326,7 @@ public:
     clsRasterData<MaskT> *getMask() const { return m_mask; }
 
     /*!
-     * \brief Copy clsRasterData object
+     * \brief Copy clsRasterData object. Raster data is copied, while the position index is shared.
      */
     void Copy(const clsRasterData<T, MaskT> *orgraster);
 
@@ -668,6 +3340,35 @@ public:
      */
     void reclassify(map<int, T> reclassMap);
 
+    /*!
+     * \brief Build the packed validity bitmask from current values, one bit per cell and layer,
+     *        1 for valid and 0 for NODATA. Once built, it is maintained by setValue, replaceNoData,
+     *        and reclassify, and consulted by statistics, replaceNoData, and compact GridFS output
+     *        instead of comparing each value with NODATA. It is released once raster data is
+     *        rebuilt, e.g., masked or reloaded.
+     */
+    void buildValidityMask();
+
+    //! Release the validity bitmask
+    void releaseValidityMask() { vector<uint64_t>().swap(m_validityMask); }
+
+    //! Is the validity bitmask built?
+    bool hasValidityMask() const { return !m_validityMask.empty(); }
+
+    //! Number of 64-bit words of the validity bitmask of one layer
+    int getValidityWordNumber() const { return m_nCells > 0 ? (m_nCells + 63) / 64 : 0; }
+
+    /*!
+     * \brief Get the validity bitmask of the given layer, bit i % 64 of word i / 64 for cell index i,
+     *        \sa getValidityWordNumber
+     * \param[in] lyr Layer number, starts from 1
+     * \return nullptr if the validity bitmask is not built
+     */
+    const uint64_t *getValidityMask(int lyr = 1) const {
+        if (m_validityMask.empty() || lyr < 1 || lyr > (m_is2DRaster ? m_nLyrs : 1)) return nullptr;
+        return &m_validityMask[(size_t) (lyr - 1) * this->getValidityWordNumber()];
+    }
+
     /************* Utility functions ***************/
 
     /*!
@@ -758,6 +3459,26 @@ private:
      */
     bool _write_ASC_headers(string filename, map<string, double> &header);
 
+    /*!
+     * \brief Write the given layer's data into a single ASC file, including the header
+     * \param[in] filename \a string, output ASC file path
+     * \param[in] lyr Layer index, starts from 0
+     */
+    bool _write_ASC_layer(string filename, int lyr);
+
+    /*!
+     * \brief Format rows of the given layer into ASC text, NoDATA included
+     * \param[in] lyr Layer index, starts from 0
+     * \param[in] rowStart, rowEnd Row range [rowStart, rowEnd)
+     * \param[out] out Formatted text, which will be cleared first
+     */
+    void _format_ASC_rows(int lyr, int rowStart, int rowEnd, string &out);
+
+    /*!
+     * \brief Get the number of threads for writing layers concurrently, at most the layer number
+     */
+    int _get_output_thread_number() const;
+
     /*!
      * \brief Write single geotiff file
      * If the file exists, delete it first.
@@ -765,8 +3486,143 @@ private:
      * \param[in] header header information
      * \param[in] srs Coordinate system string
      * \param[in] values float raster data array
+     * \param[in] blockSize Tile size of the tiled GeoTIFF, 0 means striped
+     */
+    bool _write_single_geotiff(string filename, map<string, double> &header, string srs, float *values,
+                               int blockSize = 0);
+
+    /*!
+     * \brief Write single tiled GeoTIFF file with internal overviews, i.e., COG layout
+     * If the file exists, delete it first.
+     * \param[in] filename \a string, output TIFF file path
+     * \param[in] header header information
+     * \param[in] srs Coordinate system string
+     * \param[in] values float raster data array with full size, i.e., nRows * nCols
+     * \param[in] blockSize tile size
+     */
+    bool _write_single_cog(string filename, map<string, double> &header, string srs,
+                           float *values, int blockSize);
+
+    /*!
+     * \brief Scatter the given layer's data to a full size array (nRows * nCols), NoDATA included.
+     * \param[in] lyr Layer index, starts from 0
+     * \param[out] values Allocated array with the length of nRows * nCols
+     */
+    template<typename TD>
+    void _build_fullsize_layer_data(int lyr, TD *values) const {
+        this->_build_window_layer_data(lyr, 0, int(m_headers.at(HEADER_RS_NROWS)), values);
+    }
+
+    /*!
+     * \brief Scatter a window of rows of the given layer's data to a full size array (rowCount * nCols)
+     * \param[in] lyr Layer index, starts from 0
+     * \param[in] rowStart First row of the window, starts from 0
+     * \param[in] rowCount Row number of the window
+     * \param[out] values Allocated array with the length of rowCount * nCols
+     */
+    template<typename TD>
+    void _build_window_layer_data(int lyr, int rowStart, int rowCount, TD *values) const {
+        this->_build_window_layer_data(lyr, rowStart, rowCount, 0, int(m_headers.at(HEADER_RS_NCOLS)), values);
+    }
+
+    /*!
+     * \brief Scatter a window of the given layer's data to a full size array (rowCount * colCount), NoDATA included.
+     * \param[in] lyr Layer index, starts from 0
+     * \param[in] rowStart, rowCount First row and row number of the window
+     * \param[in] colStart, colCount First column and column number of the window
+     * \param[out] values Allocated array with the length of rowCount * colCount
      */
-    bool _write_single_geotiff(string filename, map<string, double> &header, string srs, float *values);
+    template<typename TD>
+    void _build_window_layer_data(int lyr, int rowStart, int rowCount, int colStart, int colCount,
+                                  TD *values) const;
+
+    /*!
+     * \brief Typed snapshot of raster shared with clsRasterStorageMemory, \sa outputToStorage, ReadFromStorage
+     */
+    class StorageSnapshot : public clsRasterStorageMemory::RasterHandle {
+    public:
+        explicit StorageSnapshot(const clsRasterData<T, MaskT> *raster) {
+            m_raster.Copy(raster);
+            m_raster.m_mask = nullptr;  /// the positions are shared, and the mask may be released before
+        }
+
+        void readWindow(int lyr, int rowStart, int rowCount, double *values) const override {
+            m_raster._build_window_layer_data(lyr - 1, rowStart, rowCount, values);
+        }
+
+        clsRasterData<T, MaskT> m_raster;  ///< Copy of raster data, compact if the positions are calculated
+    };
+
+    /*!
+     * \brief Release raster data, positions (if stored), and 2D statistics.
+     */
+    void _release_raster_data();
+
+    /*!
+     * \brief Release 2D raster data, either contiguous or adopted from the caller
+     * \param[in] nCells Cell number of the allocated 2D raster data
+     */
+    void _release_2d_data(int nCells);
+
+    /*!
+     * \brief Hold the given position index, and update m_rasterPositionData accordingly
+     * \param[in] index Position index, nullptr to release position data
+     */
+    void _set_position_index(const shared_ptr<clsRasterPositionIndex> &index);
+
+    //! Hold a new position index adopting \a positions of m_nCells valid cells
+    void _adopt_positions(int **positions);
+
+    //! Share the position index of the mask, which is calculated if necessary
+    void _share_mask_positions();
+
+    //! Release 1D raster data, either aligned or adopted from the caller
+    void _release_1d_data();
+
+    //! Set or clear the validity bit of cell index and layer (starts from 0), if the bitmask is built
+    void _set_validity_bit(int cellIndex, int lyr, bool valid) {
+        if (m_validityMask.empty()) return;
+        uint64_t &word = m_validityMask[(size_t) lyr * this->getValidityWordNumber() + cellIndex / 64];
+        uint64_t bit = (uint64_t) 1 << (cellIndex % 64);
+        word = valid ? word | bit : word & ~bit;
+    }
+
+    /*!
+     * \brief Basic statistics of one layer, i.e., valid number, mean, max, min, std, and range
+     * \param[in] lyr Layer index, starts from 0
+     * \param[out] derived Allocated array of 6 values, MUST be released by Release1DArray
+     */
+    void _layer_statistics(int lyr, double **derived);
+
+    //! Reference of the value of valid cell index and layer (starts from 0) in 2D raster data, honoring the layout
+    T &_2d_value(int cellIndex, int lyr) const {
+        return m_layout == RL_LayerMajor ? m_raster2DData[lyr][cellIndex] : m_raster2DData[cellIndex][lyr];
+    }
+
+    /*!
+     * \brief Mark the tile which contains (row, col) of the given layer as dirty, thread-safe.
+     * \param[in] lyr Layer index, starts from 0
+     */
+    inline void _mark_dirty_tile(int row, int col, int lyr) {
+        if (m_tileSize <= 0) return;
+        int ntilecols = (this->getCols() + m_tileSize - 1) / m_tileSize;
+        int ntilerows = (this->getRows() + m_tileSize - 1) / m_tileSize;
+        int idx = (lyr * ntilerows + row / m_tileSize) * ntilecols + col / m_tileSize;
+#pragma omp atomic
+        m_dirtyTiles[idx] |= 1;
+    }
+
+    /*!
+     * \brief Mark the tile which contains the cell of the valid cell index as dirty, \sa _mark_dirty_tile
+     */
+    inline void _mark_dirty_cell(int cellIndex, int lyr) {
+        if (m_tileSize <= 0) return;
+        if (nullptr != m_rasterPositionData) {
+            this->_mark_dirty_tile(m_rasterPositionData[cellIndex][0], m_rasterPositionData[cellIndex][1], lyr);
+        } else {
+            this->_mark_dirty_tile(cellIndex / this->getCols(), cellIndex % this->getCols(), lyr);
+        }
+    }
 
 #ifdef USE_MONGODB
 
@@ -776,14 +3632,83 @@ private:
      * \param[in] filename \a string, GridFS file name
      * \param[in] header header information
      * \param[in] srs Coordinate system string
-     * \param[in] values float raster data array
+     * \param[in] payload Raw payload, e.g., the full-sized raster data array in its native type
+     * \param[in] bytes Bytes of \a payload
+     * \param[in] layout Layout of the payload, empty means the full-sized array
      */
     void _write_stream_data_as_gridfs(MongoGridFS *gfs,
                                       string filename,
                                       map<string, double> &header,
                                       string srs,
-                                      T *values,
-                                      size_t datalength);
+                                      const char *payload,
+                                      size_t bytes,
+                                      string layout = "");
+
+    /*!
+     * \brief Write valid cells and the run-length positions as GridFS file, \sa outputToMongoDB
+     */
+    void _write_compact_gridfs(string filename, MongoGridFS *gfs);
+
+    /*!
+     * \brief Read the compact payload of GridFS, \sa ReadFromMongoDB
+     * \param[in] buf Payload
+     * \param[in] dtype Data type of values
+     * \param[in] nRuns Number of runs
+     * \param[in] nValidCells Number of valid cells
+     */
+    void _read_compact_gridfs(const char *buf, RasterDataType dtype, int nRuns, int nValidCells);
+
+    /*!
+     * \brief Store full-sized data of GridFS, which is stored as type TS, into raster data of type T
+     * \param[in] values Full-sized raster data, layer is the fastest varying dimension
+     * \param[in] reBuildData If false, only the valid cells of the mask are stored.
+     */
+    template<typename TS>
+    void _store_gridfs_data(const TS *values, bool reBuildData);
+
+    /*!
+     * \brief Allocate raster data for the data read from GridFS, \sa _store_gridfs_data
+     */
+    void _allocate_gridfs_data();
+
+    /*!
+     * \brief Store a chunk of the full-sized and pixel interleaved data into the allocated raster data
+     * \param[in] values Chunk data of type TS
+     * \param[in] first Index of the first element of the chunk in the full-sized data
+     * \param[in] n Element number of the chunk
+     * \param[in] nLyrs Layer number of the full-sized data
+     * \param[in] lyrOffset Index of raster layer which the first layer of data is stored to
+     * \param[in] reBuildData If false, only the valid cells of the mask are stored.
+     * \param[in,out] cursor Index of the first valid cell which may be covered by this chunk,
+     *                 starts from 0 and is updated for the next chunk
+     */
+    template<typename TS>
+    void _store_gridfs_chunk(const TS *values, size_t first, int n, int nLyrs, int lyrOffset,
+                             bool reBuildData, int &cursor);
+
+    /*!
+     * \brief Store a chunk of the full-sized data stored as \a dtype into the allocated raster data
+     * \param[in] values Chunk data
+     * \param[in] dtype Data type of \a values
+     * \param[in] first Index of the first element of the chunk in the full-sized data
+     * \param[in] n Element number of the chunk
+     * \param[in] band The full-sized data is band interleaved (layer-major) or pixel interleaved
+     * \param[in] reBuildData If false, only the valid cells of the mask are stored.
+     * \param[in,out] cursor \sa _store_gridfs_chunk
+     */
+    bool _store_gridfs_raw_chunk(const char *values, RasterDataType dtype, size_t first, int n,
+                                 bool band, bool reBuildData, int &cursor);
+
+    /*!
+     * \brief Read the full-sized data of GridFS chunk by chunk into the allocated raster data,
+     *        i.e., no staging buffer of the whole file.
+     * \param[in] gfile Opened GridFS file
+     * \param[in] dtype Data type of the stored data
+     * \param[in] band The full-sized data is band interleaved (layer-major) or pixel interleaved
+     * \param[in] reBuildData If false, only the valid cells of the mask are stored.
+     * \return false if the file is shorter than expected
+     */
+    bool _stream_gridfs_data(mongoc_gridfs_file_t *gfile, RasterDataType dtype, bool band, bool reBuildData);
 
 #endif /* USE_MONGODB */
 
@@ -806,6 +3731,11 @@ private:
     }
 
 private:
+    /*!
+     * \brief Copy constructor without implementation, use clsRasterData(clsRasterData*) or Copy() instead
+     */
+    clsRasterData(const clsRasterData &another);
+
     /*!
      * \brief Operator= without implementation
      */
@@ -832,10 +3762,20 @@ private:
     string m_srs;
     ///< 1D raster data
     T *m_rasterData;
-    ///< 2D raster data, [cellIndex][layer]
+    ///< m_rasterData is allocated by _initialize_1d_buffer (true), or adopted from the caller (false)
+    bool m_alignedData;
+    ///< 2D raster data, [cellIndex][layer] or [layer][cellIndex] according to m_layout,
+    ///< i.e., row pointers of one contiguous buffer
     T **m_raster2DData;
-    ///< cell index (row, col) in m_rasterData or the first layer of m_raster2DData (2D array)
+    ///< m_raster2DData is allocated by _initialize_2d_buffer (true), or adopted from the caller (false)
+    bool m_contiguous2D;
+    ///< Memory layout of m_raster2DData
+    RasterLayout m_layout;
+    ///< cell index (row, col) in m_rasterData or the first layer of m_raster2DData (2D array),
+    ///< i.e., row pointers of the packed (row, col) pairs held by m_positionIndex
     int **m_rasterPositionData;
+    ///< Shared position index, nullptr if position data is not calculated
+    shared_ptr<clsRasterPositionIndex> m_positionIndex;
     ///< Header information, using double in case of truncation of coordinate value
     map<string, double> m_headers;
     //! Map to store basic statistics values for 1D raster data
@@ -850,12 +3790,26 @@ private:
     bool m_is2DRaster;
     ///< calculate valid positions or not. The default is true.
     bool m_calcPositions;
-    ///< raster position data is newly allocated array (true), or just a pointer (false)
+    ///< raster position data is calculated by this raster (true), or shared from the mask (false)
     bool m_storePositions;
     ///< To be consistent with other datesets, keep the extent of Mask layer, even include NoDATA.
     bool m_useMaskExtent;
     ///< Statistics calculated?
     bool m_statisticsCalculated;
+    ///< Tile size for tracking modified tiles, 0 means not tracked.
+    int m_tileSize;
+    ///< Thread number for writing layers concurrently, 0 means the default of OpenMP.
+    int m_nOutputThreads;
+    ///< Dirty marks of tiles, [layer][tileRow][tileCol]
+    vector<int> m_dirtyTiles;
+    ///< Block compression of payloads written into GridFS
+    RasterCompression m_gfsCompression;
+    ///< Uncompressed bytes of compression blocks
+    int m_gfsBlockSize;
+    ///< Layers of 2D raster are stored band interleaved into GridFS
+    bool m_gfsBandInterleaved;
+    ///< Validity bitmask, [layer][word], empty if not built, \sa buildValidityMask
+    vector<uint64_t> m_validityMask;
 };
 
 /*******************************************************/
@@ -872,15 +3826,26 @@ void clsRasterData<T, MaskT>::_initialize_raster_class() {
     m_noDataValue = (T) NODATA_VALUE;
     m_defaultValue = (T) NODATA_VALUE;
     m_rasterData = nullptr;
+    m_alignedData = true;
     m_rasterPositionData = nullptr;
     m_mask = nullptr;
     m_nLyrs = -1;
     m_is2DRaster = false;
     m_raster2DData = nullptr;
+    m_contiguous2D = true;
+    m_layout = RL_CellMajor;
+    m_positionIndex.reset();
+    m_validityMask.clear();
     m_calcPositions = false;
     m_storePositions = false;
     m_useMaskExtent = false;
     m_statisticsCalculated = false;
+    m_tileSize = 0;
+    m_dirtyTiles.clear();
+    m_nOutputThreads = 0;
+    m_gfsCompression = RCP_None;
+    m_gfsBlockSize = GridFSBlockSize;
+    m_gfsBandInterleaved = false;
     const char *RASTER_HEADERS[8] = {HEADER_RS_NCOLS, HEADER_RS_NROWS, HEADER_RS_XLL, HEADER_RS_YLL, HEADER_RS_CELLSIZE,
                                      HEADER_RS_NODATA, HEADER_RS_LAYERS, HEADER_RS_CELLSNUM};
     for (int i = 0; i < 6; i++) {
@@ -921,6 +3886,7 @@ clsRasterData<T, MaskT>::clsRasterData(T *data, int cols, int rows, T nodata, do
                                        double xll, double yll, const string &srs /* = "" */) {
     this->_initialize_raster_class();
     m_rasterData = data;
+    m_alignedData = false;  /// allocated by the caller, e.g., Initialize1DArray
     m_noDataValue = nodata;
     m_srs = srs;
     m_nCells = cols * rows;
@@ -940,6 +3906,7 @@ clsRasterData<T, MaskT>::clsRasterData(T **data2d, int cols, int rows, int nlaye
                                        double xll, double yll, const string &srs /* = "" */) {
     this->_initialize_raster_class();
     m_raster2DData = data2d;
+    m_contiguous2D = false;  /// allocated by the caller, e.g., Initialize2DArray
     m_is2DRaster = true;
     m_noDataValue = nodata;
     m_srs = srs;
@@ -1008,12 +3975,12 @@ clsRasterData<T, MaskT>::clsRasterData(vector<string> &filenames,
         ///    string layerFilepath = m_filePathName.replace(m_filePathName.find_last_of("%d") - 1, 2, ValueToString(1));
         /// 3. initialize m_raster2DData and read the other layers according to position data if stated,
         ///     or just read by row and col
-        Initialize2DArray(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
 #pragma omp parallel for
         for (int i = 0; i < m_nCells; i++) {
             m_raster2DData[i][0] = m_rasterData[i];
         }
-        Release1DArray(m_rasterData);
+        this->_release_1d_data();
         /// take the first layer as mask, and useMaskExtent is true, and no need to calculate position data
         //for (vector<string>::iterator iter = filenames.begin(); iter != filenames.end(); iter++){
         for (size_t fileidx = 1; fileidx < filenames.size(); fileidx++) {
@@ -1042,7 +4009,7 @@ clsRasterData<T, MaskT>::clsRasterData(vector<string> &filenames,
                     }
                 }
             }
-            Release1DArray(tmplyrdata);
+            _release_aligned_buffer(tmplyrdata);
         }
         m_is2DRaster = true;
         m_headers.at(HEADER_RS_LAYERS) = m_nLyrs;  // repair layers count in headers
@@ -1076,13 +4043,13 @@ clsRasterData<T, MaskT>::clsRasterData(clsRasterData<MaskT> *mask, const T *valu
     m_mask = mask;
     m_nLyrs = mask->getLayers();
     m_nCells = m_mask->getCellNumber();
-    Initialize1DArray(m_nCells, m_rasterData, values); // DO NOT ASSIGN ARRAY DIRECTLY, IN CASE OF MEMORY ERROR!
+    _initialize_1d_buffer(m_nCells, m_rasterData, values); // DO NOT ASSIGN ARRAY DIRECTLY, IN CASE OF MEMORY ERROR!
     this->copyHeader(m_mask->getRasterHeader());
     m_srs = m_mask->getSRSString();
     m_defaultValue = m_mask->getDefaultValue();
     m_calcPositions = false;
     if (mask->PositionsCalculated()) {
-        mask->getRasterPositionData(&m_nCells, &m_rasterPositionData);
+        this->_share_mask_positions();
     }
     m_useMaskExtent = true;
 }
@@ -1096,11 +4063,11 @@ clsRasterData<T, MaskT>::clsRasterData(clsRasterData<MaskT> *mask, const T *cons
     m_headers.at(HEADER_RS_LAYERS) = m_nLyrs;
     m_srs = m_mask->getSRSString();
     m_nCells = m_mask->getCellNumber();
-    Initialize2DArray(m_nCells, m_nLyrs, m_raster2DData, values); // DO NOT ASSIGN ARRAY DIRECTLY!
+    _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, values); // DO NOT ASSIGN ARRAY DIRECTLY!
     m_defaultValue = m_mask->getDefaultValue();
     m_useMaskExtent = true;
     if (mask->PositionsCalculated()) {
-        mask->getRasterPositionData(&m_nCells, &m_rasterPositionData);
+        this->_share_mask_positions();
     }
     m_is2DRaster = true;
 }
@@ -1126,6 +4093,37 @@ clsRasterData<T, MaskT> *clsRasterData<T, MaskT>::Init(MongoGridFS *gfs, const c
     return new clsRasterData<T, MaskT>(gfs, remoteFilename, calcPositions, mask, useMaskExtent, defalutValue);
 };
 
+template<typename T, typename MaskT>
+vector<clsRasterData<T, MaskT> *> clsRasterData<T, MaskT>::BatchInit(mongoc_client_pool_t *pool,
+                                                                     const string &dbname,
+                                                                     const string &gfsname,
+                                                                     const vector<string> &remoteFilenames,
+                                                                     bool calcPositions /* = true */,
+                                                                     clsRasterData<MaskT> *mask /* = nullptr */,
+                                                                     bool useMaskExtent /* = true */,
+                                                                     int nThreads /* = 0 */,
+                                                                     T defalutValue /* = (T) NODATA_VALUE */) {
+    int nfiles = (int) remoteFilenames.size();
+    vector<clsRasterData<T, MaskT> *> rasters(nfiles, nullptr);
+    if (nullptr == pool || nfiles == 0) return rasters;
+    /// positions of the mask are calculated once before being shared by workers
+    if (nullptr != mask) {
+        int nvalid;
+        int **positions = nullptr;
+        mask->getRasterPositionData(&nvalid, &positions);
+    }
+    _run_gridfs_workers(pool, dbname, gfsname, nfiles, nThreads, [&](int i, MongoGridFS *gfs) {
+        if (nullptr == gfs) return;
+        clsRasterData<T, MaskT> *rs = new clsRasterData<T, MaskT>();
+        if (rs->ReadFromMongoDB(gfs, remoteFilenames[i], calcPositions, mask, useMaskExtent, defalutValue)) {
+            rasters[i] = rs;
+        } else {
+            delete rs;
+        }
+    });
+    return rasters;
+}
+
 #endif /* USE_MONGODB */
 
 template<typename T, typename MaskT>
@@ -1158,9 +4156,9 @@ bool clsRasterData<T, MaskT>::_construct_from_single_file(string filename, bool
 template<typename T, typename MaskT>
 clsRasterData<T, MaskT>::~clsRasterData() {
     StatusMessage(("Release raster: " + m_coreFileName).c_str());
-    if (nullptr != m_rasterData) Release1DArray(m_rasterData);
-    if (nullptr != m_rasterPositionData && m_storePositions) Release2DArray(m_nCells, m_rasterPositionData);
-    if (nullptr != m_raster2DData && m_is2DRaster) Release2DArray(m_nCells, m_raster2DData);
+    this->_release_1d_data();
+    this->_set_position_index(nullptr);
+    if (m_is2DRaster) this->_release_2d_data(m_nCells);
     if (m_is2DRaster && m_statisticsCalculated) this->releaseStatsMap2D();
 }
 
@@ -1170,7 +4168,22 @@ void clsRasterData<T, MaskT>::calculateStatistics() {
     if (this->m_statisticsCalculated) return;
     if (m_is2DRaster && nullptr != m_raster2DData) {
         double **derivedvs;
-        basicStatistics(m_raster2DData, m_nCells, m_nLyrs, &derivedvs, m_noDataValue);
+        if (m_layout == RL_LayerMajor || this->hasValidityMask()) {  // statistics layer by layer
+            derivedvs = new double *[6];
+            for (int k = 0; k < 6; k++) {
+                derivedvs[k] = new double[m_nLyrs];
+            }
+            for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+                double *derivedv = nullptr;
+                this->_layer_statistics(lyr, &derivedv);
+                for (int k = 0; k < 6; k++) {
+                    derivedvs[k][lyr] = derivedv[k];
+                }
+                Release1DArray(derivedv);
+            }
+        } else {
+            basicStatistics(m_raster2DData, m_nCells, m_nLyrs, &derivedvs, m_noDataValue);
+        }
         if (m_statsMap2D.empty()) {
             m_statsMap2D.insert(map<string, double *>::value_type(STATS_RS_VALIDNUM, derivedvs[0]));
             m_statsMap2D.insert(map<string, double *>::value_type(STATS_RS_MEAN, derivedvs[1]));
@@ -1191,7 +4204,7 @@ void clsRasterData<T, MaskT>::calculateStatistics() {
         derivedvs = nullptr;
     } else {
         double *derivedv = nullptr;
-        basicStatistics(m_rasterData, m_nCells, &derivedv, m_noDataValue);
+        this->_layer_statistics(0, &derivedv);
         m_statsMap.at(STATS_RS_VALIDNUM) = derivedv[0];
         m_statsMap.at(STATS_RS_MEAN) = derivedv[1];
         m_statsMap.at(STATS_RS_MAX) = derivedv[2];
@@ -1203,6 +4216,75 @@ void clsRasterData<T, MaskT>::calculateStatistics() {
     this->m_statisticsCalculated = true;
 }
 
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_layer_statistics(int lyr, double **derived) {
+    const uint64_t *words = this->getValidityMask(lyr + 1);
+    int validnum = 0;
+    for (int w = 0; nullptr != words && w < this->getValidityWordNumber(); w++) {
+        validnum += _count_bits(words[w] & _bit_word_mask(m_nCells, w));
+    }
+    if (validnum > 0) {  /// only visit the valid cells, without comparing with NODATA
+        double sum = 0.;
+        double maxv = 0.;
+        double minv = 0.;
+        bool first = true;
+        _for_each_set_bit(words, m_nCells, [&](int i) {
+            double v = m_is2DRaster ? (double) this->_2d_value(i, lyr) : (double) m_rasterData[i];
+            sum += v;
+            if (first || v > maxv) maxv = v;
+            if (first || v < minv) minv = v;
+            first = false;
+        });
+        double mean = sum / validnum;
+        double sqsum = 0.;
+        _for_each_set_bit(words, m_nCells, [&](int i) {
+            double v = m_is2DRaster ? (double) this->_2d_value(i, lyr) : (double) m_rasterData[i];
+            sqsum += (v - mean) * (v - mean);
+        });
+        double *values = new double[6];
+        values[0] = validnum;
+        values[1] = mean;
+        values[2] = maxv;
+        values[3] = minv;
+        values[4] = sqrt(sqsum / validnum);
+        values[5] = maxv - minv;
+        *derived = values;
+    } else if (!m_is2DRaster) {
+        basicStatistics(m_rasterData, m_nCells, derived, m_noDataValue);
+    } else if (m_layout == RL_LayerMajor) {
+        basicStatistics(m_raster2DData[lyr], m_nCells, derived, m_noDataValue);
+    } else {
+        vector<T> values(m_nCells > 0 ? m_nCells : 1);
+        for (int i = 0; i < m_nCells; i++) {
+            values[i] = m_raster2DData[i][lyr];
+        }
+        basicStatistics(&values[0], m_nCells, derived, m_noDataValue);
+    }
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::buildValidityMask() {
+    if (!this->validate_raster_data() || m_nCells <= 0) return;
+    int nwords = this->getValidityWordNumber();
+    int nlyrs = m_is2DRaster ? m_nLyrs : 1;
+    int ncells = m_nCells;
+    m_validityMask.assign((size_t) nlyrs * nwords, 0);
+    for (int lyr = 0; lyr < nlyrs; lyr++) {
+        uint64_t *words = &m_validityMask[(size_t) lyr * nwords];
+#pragma omp parallel for
+        for (int w = 0; w < nwords; w++) {
+            uint64_t word = 0;
+            int end = ncells - w * 64 < 64 ? ncells - w * 64 : 64;
+            for (int b = 0; b < end; b++) {
+                int i = w * 64 + b;
+                T v = m_is2DRaster ? this->_2d_value(i, lyr) : m_rasterData[i];
+                if (!FloatEqual(v, m_noDataValue)) word |= (uint64_t) 1 << b;
+            }
+            words[w] = word;
+        }
+    }
+}
+
 template<typename T, typename MaskT>
 void clsRasterData<T, MaskT>::releaseStatsMap2D() {
     for (auto it = m_statsMap2D.begin(); it != m_statsMap2D.end();) {
@@ -1288,6 +4370,10 @@ int clsRasterData<T, MaskT>::getPosition(int row, int col) {
     if (!m_calcPositions || nullptr == m_rasterPositionData) {
         return this->getCols() * row + col;
     }
+    const clsRasterSpanIndex *spans = this->getSpanIndex();
+    if (nullptr != spans) {
+        return spans->find(row, col);  // -1 means the location is NODATA
+    }
     for (int i = 0; i < m_nCells; i++) {
         if (row == m_rasterPositionData[i][0] && col == m_rasterPositionData[i][1]) {
             return i;
@@ -1384,7 +4470,7 @@ T clsRasterData<T, MaskT>::getValueByIndex(int cellIndex, int lyr /* = 1 */) {
         return m_noDataValue;
     }
     if (m_is2DRaster) {
-        return m_raster2DData[cellIndex][lyr - 1];
+        return this->_2d_value(cellIndex, lyr - 1);
     } else {
         return m_rasterData[cellIndex];
     }
@@ -1400,7 +4486,7 @@ void clsRasterData<T, MaskT>::getValueByIndex(int cellIndex, int *nLyrs, T **val
     if (m_is2DRaster) {
         T *cellValues = new T[m_nLyrs];
         for (int i = 0; i < m_nLyrs; i++) {
-            cellValues[i] = m_raster2DData[cellIndex][i];
+            cellValues[i] = this->_2d_value(cellIndex, i);
         }
         *nLyrs = m_nLyrs;
         *values = cellValues;
@@ -1425,7 +4511,7 @@ T clsRasterData<T, MaskT>::getValue(int row, int col, int lyr /* = 1 */) {
         return this->getValueByIndex(validCellIndex, lyr);
     } else { // get data directly from row and col
         if (m_is2DRaster) {
-            return m_raster2DData[row * this->getCols() + col][lyr - 1];
+            return this->_2d_value(row * this->getCols() + col, lyr - 1);
         } else {
             return m_rasterData[row * this->getCols() + col];
         }
@@ -1458,7 +4544,7 @@ void clsRasterData<T, MaskT>::getValue(int row, int col, int *nLyrs, T **values)
         if (m_is2DRaster) {
             T *cellValues = new T[m_nLyrs];
             for (int i = 0; i < m_nLyrs; i++) {
-                cellValues[i] = m_raster2DData[row * this->getCols() + col][i];
+                cellValues[i] = this->_2d_value(row * this->getCols() + col, i);
             }
             *nLyrs = m_nLyrs;
             *values = cellValues;
@@ -1482,14 +4568,56 @@ void clsRasterData<T, MaskT>::setValue(int row, int col, T value, int lyr /* = 1
         print_status("Current version do not support to setting value to NoDATA location!");
     } else {
         if (m_is2DRaster) {
-            m_raster2DData[idx][lyr - 1] = value;
+            this->_2d_value(idx, lyr - 1) = value;
         } else {
             m_rasterData[idx] = value;
         }
+        this->_set_validity_bit(idx, lyr - 1, !FloatEqual(value, m_noDataValue));
+        this->_mark_dirty_tile(row, col, lyr - 1);
     }
     return;
 }
 
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::setDirtyTileTracking(int tileSize /* = 256 */) {
+    if (tileSize < 0 || tileSize % 16 != 0) {
+        print_status("The tile size of GeoTIFF must be a multiple of 16!");
+        return false;
+    }
+    m_tileSize = tileSize;
+    m_dirtyTiles.clear();
+    if (m_tileSize == 0) return true;
+    if (!this->validate_raster_data()) {
+        m_tileSize = 0;
+        return false;
+    }
+    int ntilecols = (this->getCols() + m_tileSize - 1) / m_tileSize;
+    int ntilerows = (this->getRows() + m_tileSize - 1) / m_tileSize;
+    m_dirtyTiles.resize(ntilerows * ntilecols * m_nLyrs, 0);
+    return true;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::clearDirtyTiles() {
+    std::fill(m_dirtyTiles.begin(), m_dirtyTiles.end(), 0);
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::setGridFSCompression(RasterCompression codec,
+                                                   int blockSize /* = GridFSBlockSize */) {
+    if (!RasterCompressionSupported(codec)) {
+        print_status("The compression " + RasterCompressionToString(codec) + " is not supported!");
+        return false;
+    }
+    if (blockSize <= 0) {
+        print_status("The block size of compression must be positive!");
+        return false;
+    }
+    m_gfsCompression = codec;
+    m_gfsBlockSize = blockSize;
+    return true;
+}
+
 /************* Output to file functions ***************/
 
 template<typename T, typename MaskT>
@@ -1508,120 +4636,145 @@ bool clsRasterData<T, MaskT>::outputToFile(string filename) {
 }
 
 template<typename T, typename MaskT>
-bool clsRasterData<T, MaskT>::_write_ASC_headers(string filename, map<string, double> &header) {
-    DeleteExistedFile(filename);
+bool clsRasterData<T, MaskT>::_write_ASC_headers(string filename, map<string, double> &header) {
+    return _write_asc_headers(filename, header);
+}
+
+template<typename T, typename MaskT>
+int clsRasterData<T, MaskT>::_get_output_thread_number() const {
+    int nthreads = m_nOutputThreads;
+#ifdef SUPPORT_OMP
+    if (nthreads <= 0) nthreads = omp_get_max_threads();
+#else
+    nthreads = 1;
+#endif /* SUPPORT_OMP */
+    if (nthreads > m_nLyrs) nthreads = m_nLyrs;
+    return nthreads < 1 ? 1 : nthreads;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_format_ASC_rows(int lyr, int rowStart, int rowEnd, string &out) {
+    int cols = this->getCols();
+    out.clear();
+    out.reserve((size_t) (rowEnd - rowStart) * cols * 10);
+    char nodatabuf[32];
+    /// NoDATA of 2D raster is always written as the default NODATA_VALUE
+    int nodatalen = m_is2DRaster ? _format_ascii_value(NODATA_VALUE, nodatabuf)
+                                 : _format_ascii_value(m_noDataValue, nodatabuf);
+    nodatabuf[nodatalen++] = ' ';
+    char buf[32];
+    bool outputdirectly = nullptr == m_rasterPositionData;
+    int index = 0;
+    const clsRasterSpanIndex *spans = outputdirectly ? nullptr : this->getSpanIndex();
+    if (nullptr != spans) {  /// the first valid cell in or after rowStart
+        index = spans->getSpanStart(spans->getRowSpanBegin(rowStart));
+    } else if (!outputdirectly) {  /// positions are sorted by row and then column
+        int last = m_nCells;
+        while (index < last) {
+            int mid = index + (last - index) / 2;
+            if (m_rasterPositionData[mid][0] < rowStart) {
+                index = mid + 1;
+            } else {
+                last = mid;
+            }
+        }
+    }
+    for (int i = rowStart; i < rowEnd; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            if (outputdirectly) {
+                index = i * cols + j;
+            } else if (index >= m_nCells || m_rasterPositionData[index][0] != i ||
+                m_rasterPositionData[index][1] != j) {
+                out.append(nodatabuf, nodatalen);
+                continue;
+            }
+            int len = _format_ascii_value(m_is2DRaster ? this->_2d_value(index, lyr) : m_rasterData[index], buf);
+            buf[len++] = ' ';
+            out.append(buf, len);
+            if (!outputdirectly) index++;
+        }
+        out.push_back('\n');
+    }
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::_write_ASC_layer(string filename, int lyr) {
+    if (!this->_write_ASC_headers(filename, m_headers)) return false;
     ofstream rasterFile(filename.c_str(), ios::app | ios::out);
     if (!rasterFile.is_open()) {
         print_status("Error opening file: " + filename);
         return false;
     }
-    //write file
-    int rows = int(header.at(HEADER_RS_NROWS));
-    int cols = int(header.at(HEADER_RS_NCOLS));
-    /// write header
-    rasterFile << HEADER_RS_NCOLS << " " << cols << endl;
-    rasterFile << HEADER_RS_NROWS << " " << rows << endl;
-    rasterFile << HEADER_RS_XLL << " " << header.at(HEADER_RS_XLL) << endl;
-    rasterFile << HEADER_RS_YLL << " " << header.at(HEADER_RS_YLL) << endl;
-    rasterFile << HEADER_RS_CELLSIZE << " " << (float) header.at(HEADER_RS_CELLSIZE) << endl;
-    rasterFile << HEADER_RS_NODATA << " " << setprecision(6) << header.at(HEADER_RS_NODATA) << endl;
+    int rows = int(m_headers.at(HEADER_RS_NROWS));
+    int cols = int(m_headers.at(HEADER_RS_NCOLS));
+    /// Rows are formatted by blocks (about 64K cells per block) in parallel, and then
+    /// written sequentially by large writes. Only a batch of blocks is kept in memory.
+    /// If layers are written concurrently, e.g., by outputASCFile, the rows are formatted serially
+    /// by the calling thread, so the batch is sized for one thread.
+    int blockrows = cols >= 65536 ? 1 : 65536 / cols;
+    int nthreads = 1;
+#ifdef SUPPORT_OMP
+    if (!omp_in_parallel()) nthreads = omp_get_max_threads();
+#endif /* SUPPORT_OMP */
+    int batchblocks = nthreads * 4;
+    vector<string> blocks(batchblocks);
+    bool flag = true;
+    for (int batchstart = 0; batchstart < rows && flag; batchstart += blockrows * batchblocks) {
+        int nblocks = (rows - batchstart + blockrows - 1) / blockrows;
+        if (nblocks > batchblocks) nblocks = batchblocks;
+#pragma omp parallel for schedule(dynamic) if(nthreads > 1)
+        for (int b = 0; b < nblocks; b++) {
+            int rowstart = batchstart + b * blockrows;
+            int rowend = rowstart + blockrows > rows ? rows : rowstart + blockrows;
+            this->_format_ASC_rows(lyr, rowstart, rowend, blocks[b]);
+        }
+        for (int b = 0; b < nblocks; b++) {
+            rasterFile.write(blocks[b].c_str(), blocks[b].size());
+        }
+        flag = !rasterFile.fail();
+    }
     rasterFile.close();
-    return true;
+    if (!flag) print_status("Error writing file: " + filename);
+    return flag;
 }
 
 template<typename T, typename MaskT>
 bool clsRasterData<T, MaskT>::outputASCFile(string filename) {
     filename = GetAbsolutePath(filename);
-    /// 1. Is there need to calculate valid position index?
-    int count;
-    int **position = nullptr;
-    bool outputdirectly = true;
-    if (nullptr != m_rasterPositionData) {
-        this->getRasterPositionData(&count, &position);
-        outputdirectly = false;
-        assert(nullptr != position);
-    }
-    /// 2. Write ASC raster headers first (for 1D raster data only)
-    if (!m_is2DRaster) {
-        if (!this->_write_ASC_headers(filename, m_headers)) return false;
-    }
-    /// 3. Begin to write raster data
-    int rows = int(m_headers.at(HEADER_RS_NROWS));
-    int cols = int(m_headers.at(HEADER_RS_NCOLS));
-
-    /// 3.1 2D raster data
-    if (m_is2DRaster) {
-        string prePath = GetPathFromFullName(filename);
-        if (StringMatch(prePath, "")) return false;
-        string coreName = GetCoreFileName(filename);
-        for (int lyr = 0; lyr < m_nLyrs; lyr++) {
-            stringstream oss;
-            oss << prePath << coreName << "_" << (lyr + 1) << "." << ASCIIExtension;
-            string tmpfilename = oss.str();
-            if (!this->_write_ASC_headers(tmpfilename, m_headers)) return false;
-            // write data
-            ofstream rasterFile(tmpfilename.c_str(), ios::app | ios::out);
-            if (!rasterFile.is_open()) {
-                print_status("Error opening file: " + tmpfilename);
-                return false;
-            }
-            int index = 0;
-            for (int i = 0; i < rows; ++i) {
-                for (int j = 0; j < cols; ++j) {
-                    if (outputdirectly) {
-                        index = i * cols + j;
-                        rasterFile << setprecision(6) << m_raster2DData[index][lyr] << " ";
-                        continue;
-                    }
-                    if (index < m_nCells && (position[index][0] == i && position[index][1] == j)) {
-                        rasterFile << setprecision(6) << m_raster2DData[index][lyr] << " ";
-                        index++;
-                    } else { rasterFile << setprecision(6) << NODATA_VALUE << " "; }
-                }
-                rasterFile << endl;
-            }
-            rasterFile.close();
-        }
-    } else {  /// 3.2 1D raster data
-        ofstream rasterFile(filename.c_str(), ios::app | ios::out);
-        if (!rasterFile.is_open()) {
-            print_status("Error opening file: " + filename);
-            return false;
-        }
-        int index = 0;
-        for (int i = 0; i < rows; ++i) {
-            for (int j = 0; j < cols; ++j) {
-                if (outputdirectly) {
-                    index = i * cols + j;
-                    rasterFile << setprecision(6) << m_rasterData[index] << " ";
-                    continue;
-                }
-                if (index < m_nCells) {
-                    if (position[index][0] == i && position[index][1] == j) {
-                        rasterFile << setprecision(6) << m_rasterData[index] << " ";
-                        index++;
-                    } else { rasterFile << setprecision(6) << m_noDataValue << " "; }
-                } else { rasterFile << setprecision(6) << m_noDataValue << " "; }
-            }
-            rasterFile << endl;
-        }
-        rasterFile.close();
+    /// 1. 1D raster data
+    if (!m_is2DRaster) return this->_write_ASC_layer(filename, 0);
+    /// 2. 2D raster data, each layer is written into an independent file concurrently
+    string prePath = GetPathFromFullName(filename);
+    if (StringMatch(prePath, "")) return false;
+    string coreName = GetCoreFileName(filename);
+    int failed = 0;
+#pragma omp parallel for num_threads(this->_get_output_thread_number()) reduction(+:failed)
+    for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+        stringstream oss;
+        oss << prePath << coreName << "_" << (lyr + 1) << "." << ASCIIExtension;
+        if (!this->_write_ASC_layer(oss.str(), lyr)) failed++;
     }
-    position = nullptr;
-    return true;
+    return failed == 0;
 }
 
 template<typename T, typename MaskT>
 bool clsRasterData<T, MaskT>::_write_single_geotiff(string filename,
                                                     map<string, double> &header,
-                                                    string srs, float *values) {
+                                                    string srs, float *values,
+                                                    int blockSize /* = 0 */) {
     /// 1. Create GeoTiff file driver
     GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName("GTiff");
     if (nullptr == poDriver) return false;
     char **papszOptions = nullptr;
+    if (blockSize > 0) {
+        papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", ValueToString(blockSize).c_str());
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", ValueToString(blockSize).c_str());
+    }
     int nRows = int(header.at(HEADER_RS_NROWS));
     int nCols = int(header.at(HEADER_RS_NCOLS));
     GDALDataset *poDstDS = poDriver->Create(filename.c_str(), nCols, nRows, 1, GDT_Float32, papszOptions);
+    CSLDestroy(papszOptions);
     if (nullptr == poDstDS) return false;
     /// 2. Write raster data
     GDALRasterBand *poDstBand = poDstDS->GetRasterBand(1);
@@ -1630,12 +4783,7 @@ bool clsRasterData<T, MaskT>::_write_single_geotiff(string filename,
     poDstBand->SetNoDataValue(header.at(HEADER_RS_NODATA));
     /// 3. Writer header information
     double geoTrans[6];
-    geoTrans[0] = header.at(HEADER_RS_XLL) - 0.5 * header.at(HEADER_RS_CELLSIZE);
-    geoTrans[1] = header.at(HEADER_RS_CELLSIZE);
-    geoTrans[2] = 0.;
-    geoTrans[3] = header.at(HEADER_RS_YLL) + (nRows - 0.5) * header.at(HEADER_RS_CELLSIZE);
-    geoTrans[4] = 0.;
-    geoTrans[5] = -header.at(HEADER_RS_CELLSIZE);
+    _header_to_geotransform(header, geoTrans);
     poDstDS->SetGeoTransform(geoTrans);
     poDstDS->SetProjection(srs.c_str());
     GDALClose(poDstDS);
@@ -1643,92 +4791,421 @@ bool clsRasterData<T, MaskT>::_write_single_geotiff(string filename,
     return true;
 }
 
+template<typename T, typename MaskT>
+template<typename TD>
+void clsRasterData<T, MaskT>::_build_window_layer_data(int lyr, int rowStart, int rowCount, int colStart, int colCount,
+                                                       TD *values) const {
+    int nCols = int(m_headers.at(HEADER_RS_NCOLS));
+    int colEnd = colStart + colCount;
+    if (nullptr == m_rasterPositionData) {  /// raster data is stored as full size array
+#pragma omp parallel for
+        for (int i = 0; i < rowCount; i++) {
+            int offset = (rowStart + i) * nCols + colStart;
+            TD *dst = values + i * colCount;
+            for (int j = 0; j < colCount; j++) {
+                dst[j] = m_is2DRaster ? (TD) this->_2d_value(offset + j, lyr) : (TD) m_rasterData[offset + j];
+            }
+        }
+        return;
+    }
+    int winsize = rowCount * colCount;
+#pragma omp parallel for
+    for (int i = 0; i < winsize; i++) {
+        values[i] = (TD) m_noDataValue;
+    }
+    const clsRasterSpanIndex *spans = this->getSpanIndex();
+    if (nullptr == spans) {
+#pragma omp parallel for
+        for (int i = 0; i < m_nCells; i++) {
+            int row = m_rasterPositionData[i][0];
+            int col = m_rasterPositionData[i][1];
+            if (row < rowStart || row >= rowStart + rowCount || col < colStart || col >= colEnd) continue;
+            int index = (row - rowStart) * colCount + col - colStart;
+            values[index] = m_is2DRaster ? (TD) this->_2d_value(i, lyr) : (TD) m_rasterData[i];
+        }
+        return;
+    }
+    /// scatter span by span, i.e., consecutive valid cells to consecutive columns, clipped by the window
+#pragma omp parallel for
+    for (int row = rowStart; row < rowStart + rowCount; row++) {
+        for (int s = spans->getRowSpanBegin(row); s < spans->getRowSpanEnd(row); s++) {
+            int col = spans->getSpanColumn(s);
+            int len = spans->getSpanLength(s);
+            if (col >= colEnd) break;
+            if (col + len <= colStart) continue;
+            int skip = col < colStart ? colStart - col : 0;
+            if (col + len > colEnd) len = colEnd - col;
+            len -= skip;
+            TD *dst = values + (row - rowStart) * colCount + col + skip - colStart;
+            int first = spans->getSpanStart(s) + skip;
+            if (!m_is2DRaster) {
+                for (int k = 0; k < len; k++) dst[k] = (TD) m_rasterData[first + k];
+            } else if (m_layout == RL_LayerMajor) {
+                const T *src = m_raster2DData[lyr] + first;
+                for (int k = 0; k < len; k++) dst[k] = (TD) src[k];
+            } else {
+                for (int k = 0; k < len; k++) dst[k] = (TD) m_raster2DData[first + k][lyr];
+            }
+        }
+    }
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::outputToStorage(clsRasterStorage *storage, string name) {
+    map<string, double> header = m_headers;
+    header[HEADER_RS_LAYERS] = m_nLyrs;
+    header[HEADER_RS_CELLSNUM] = -1.;
+    clsRasterStorageMemory *memory = dynamic_cast<clsRasterStorageMemory *>(storage);
+    if (nullptr != memory) {  /// keep a typed snapshot rather than converting to full size double values
+        return memory->attach(name, header, m_srs, make_shared<StorageSnapshot>(this));
+    }
+    if (!storage->create(name, header, m_srs)) {
+        print_status("Failed to create " + name + " in the storage!");
+        return false;
+    }
+    int nRows = this->getRows();
+    vector<double> values((size_t) nRows * this->getCols());
+    for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+        this->_build_fullsize_layer_data(lyr, &values[0]);
+        if (!storage->writeWindow(name, lyr + 1, 0, nRows, &values[0])) {
+            print_status("Failed to write the layer " + ValueToString(lyr + 1) + " of " + name + "!");
+            return false;
+        }
+    }
+    return true;
+}
+
 template<typename T, typename MaskT>
 bool clsRasterData<T, MaskT>::outputFileByGDAL(string filename) {
     filename = GetAbsolutePath(filename);
-    /// 1. Is there need to calculate valid position index?
-    int count;
-    int **position = nullptr;
-    bool outputdirectly = true;
-    if (nullptr != m_rasterPositionData) {
-        this->getRasterPositionData(&count, &position);
-        outputdirectly = false;
-        assert(nullptr != position);
-    }
-    /// 2. Get raster data
-    /// 2.1 2D raster data
     int nRows = int(m_headers.at(HEADER_RS_NROWS));
     int nCols = int(m_headers.at(HEADER_RS_NCOLS));
+    /// 1. 2D raster data, each layer is written into an independent file concurrently
     if (m_is2DRaster) {
         string prePath = GetPathFromFullName(filename);
         if (StringMatch(prePath, "")) return false;
         string coreName = GetCoreFileName(filename);
-        for (int lyr = 0; lyr < m_nLyrs; lyr++) {
-            stringstream oss;
-            oss << prePath << coreName << "_" << (lyr + 1) << "." << GTiffExtension;
-            string tmpfilename = oss.str();
-            float *rasterdata1D = nullptr;
-            Initialize1DArray(nRows * nCols, rasterdata1D, (float) m_noDataValue);
-            int validnum = 0;
-            for (int i = 0; i < nRows; ++i) {
-                for (int j = 0; j < nCols; ++j) {
-                    int index = i * nCols + j;
-                    if (outputdirectly) {
-                        rasterdata1D[index] = m_raster2DData[index][lyr];
-                        continue;
-                    }
-                    if (validnum < m_nCells && (position[validnum][0] == i && position[validnum][1] == j)) {
-                        rasterdata1D[index] = m_raster2DData[validnum][lyr];
-                        validnum++;
-                    }
+        /// Get the driver before writing concurrently, each thread then owns its dataset and buffer,
+        /// which is the thread-safe way of GDAL, i.e., a GDALDataset must not be shared among threads.
+        if (nullptr == GetGDALDriverManager()->GetDriverByName("GTiff")) {
+            print_status("GDAL driver GTiff is not available, please invoke GDALAllRegister() first!");
+            return false;
+        }
+        int failed = 0;
+#pragma omp parallel num_threads(this->_get_output_thread_number()) reduction(+:failed)
+        {
+            float *rasterdata1D = new float[nRows * nCols];
+#pragma omp for
+            for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+                stringstream oss;
+                oss << prePath << coreName << "_" << (lyr + 1) << "." << GTiffExtension;
+                this->_build_fullsize_layer_data(lyr, rasterdata1D);
+                if (!this->_write_single_geotiff(oss.str(), m_headers, m_srs, rasterdata1D, m_tileSize)) {
+                    failed++;
                 }
             }
-            bool outflag = this->_write_single_geotiff(tmpfilename, m_headers, m_srs, rasterdata1D);
-            Release1DArray(rasterdata1D);
-            if (!outflag) return false;
+            delete[] rasterdata1D;
         }
-    } else {  /// 3.2 1D raster data
-        float *rasterdata1D = nullptr;
-        bool newbuilddata = true;
-        if (outputdirectly) {
-            if (typeid(T) != typeid(float)) {
-                /// copyArray() should be an common used function
-                rasterdata1D = new float[m_nCells];
-                for (int i = 0; i < m_nCells; i++) {
-                    rasterdata1D[i] = (float) m_rasterData[i];
-                }
-            } else {
-                rasterdata1D = (float *) m_rasterData;
-                newbuilddata = false;
+        if (failed > 0) return false;
+        this->clearDirtyTiles();
+        return true;
+    }
+    /// 2. 1D raster data
+    float *rasterdata1D = nullptr;
+    bool newbuilddata = true;
+    if (nullptr == m_rasterPositionData && typeid(T) == typeid(float)) {
+        rasterdata1D = (float *) m_rasterData;
+        newbuilddata = false;
+    } else {
+        /// copyArray() should be an common used function
+        rasterdata1D = new float[nRows * nCols];
+        this->_build_fullsize_layer_data(0, rasterdata1D);
+    }
+    bool outflag = this->_write_single_geotiff(filename, m_headers, m_srs, rasterdata1D, m_tileSize);
+    if (!newbuilddata) { rasterdata1D = nullptr; }
+    else { Release1DArray(rasterdata1D); }
+    if (outflag) this->clearDirtyTiles();
+    return outflag;
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::updateFile(string filename) {
+    if (!this->DirtyTilesTracked()) {
+        print_status("Please enable dirty tile tracking by setDirtyTileTracking() first!");
+        return false;
+    }
+    if (!this->validate_raster_data()) return false;
+    if (!StringMatch(GetUpper(GetSuffix(filename)), GTiffExtension)) {
+        print_status("Only the tiled GeoTIFF written by outputFileByGDAL can be updated!");
+        return false;
+    }
+    filename = GetAbsolutePath(filename);
+    string prePath = GetPathFromFullName(filename);
+    string coreName = GetCoreFileName(filename);
+    int nRows = this->getRows();
+    int nCols = this->getCols();
+    int ntilecols = (nCols + m_tileSize - 1) / m_tileSize;
+    int ntilerows = (nRows + m_tileSize - 1) / m_tileSize;
+    float *tiledata = new float[m_tileSize * m_tileSize];
+    bool flag = true;
+    for (int lyr = 0; lyr < m_nLyrs && flag; lyr++) {
+        string tmpfilename = filename;
+        if (m_is2DRaster) {
+            stringstream oss;
+            oss << prePath << coreName << "_" << (lyr + 1) << "." << GTiffExtension;
+            tmpfilename = oss.str();
+        }
+        int lyrstart = lyr * ntilerows * ntilecols;
+        bool lyrdirty = false;
+        for (int i = 0; i < ntilerows * ntilecols; i++) {
+            if (m_dirtyTiles[lyrstart + i] != 0) {
+                lyrdirty = true;
+                break;
             }
-        } else {
-            Initialize1DArray(nRows * nCols, rasterdata1D, (float) m_noDataValue);
         }
-        int validnum = 0;
-        if (!outputdirectly) {
-            for (int i = 0; i < nRows; ++i) {
-                for (int j = 0; j < nCols; ++j) {
-                    int index = i * nCols + j;
-                    if (validnum < m_nCells && (position[validnum][0] == i && position[validnum][1] == j)) {
-                        rasterdata1D[index] = m_rasterData[validnum];
-                        validnum++;
-                    }
-                }
+        if (!lyrdirty) continue;
+        GDALDataset *poDataset = (GDALDataset *) GDALOpen(tmpfilename.c_str(), GA_Update);
+        if (nullptr == poDataset) {
+            print_status("Open file " + tmpfilename + " failed.");
+            flag = false;
+            break;
+        }
+        GDALRasterBand *poBand = poDataset->GetRasterBand(1);
+        int blockx = 0;
+        int blocky = 0;
+        if (nullptr != poBand) poBand->GetBlockSize(&blockx, &blocky);
+        if (nullptr == poBand || poBand->GetXSize() != nCols || poBand->GetYSize() != nRows ||
+            blockx != m_tileSize || blocky != m_tileSize) {
+            print_status("The extent or tile size of " + tmpfilename + " is inconsistent with the raster!");
+            GDALClose(poDataset);
+            flag = false;
+            break;
+        }
+        for (int tr = 0; tr < ntilerows && flag; tr++) {
+            for (int tc = 0; tc < ntilecols && flag; tc++) {
+                if (m_dirtyTiles[lyrstart + tr * ntilecols + tc] == 0) continue;
+                int xoff = tc * m_tileSize;
+                int yoff = tr * m_tileSize;
+                int xsize = xoff + m_tileSize > nCols ? nCols - xoff : m_tileSize;
+                int ysize = yoff + m_tileSize > nRows ? nRows - yoff : m_tileSize;
+                this->_build_window_layer_data(lyr, yoff, ysize, xoff, xsize, tiledata);
+                flag = CE_None == poBand->RasterIO(GF_Write, xoff, yoff, xsize, ysize, tiledata,
+                                                   xsize, ysize, GDT_Float32, 0, 0);
             }
         }
-        bool outflag = this->_write_single_geotiff(filename, m_headers, m_srs, rasterdata1D);
-        if (!newbuilddata) { rasterdata1D = nullptr; }
-        else { Release1DArray(rasterdata1D); }
-        if (!outflag) return false;
+        GDALClose(poDataset);
     }
-    position = nullptr;
-    return true;
+    delete[] tiledata;
+    if (flag) this->clearDirtyTiles();
+    return flag;
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::_write_single_cog(string filename,
+                                                map<string, double> &header,
+                                                string srs, float *values,
+                                                int blockSize) {
+    int nRows = int(header.at(HEADER_RS_NROWS));
+    int nCols = int(header.at(HEADER_RS_NCOLS));
+    float nodata = (float) header.at(HEADER_RS_NODATA);
+    /// 1. Build the overview pyramid from the in-memory data, until the coarsest level fits into one tile.
+    vector<float *> levels;
+    vector<int> levelRows;
+    vector<int> levelCols;
+    vector<int> factors;
+    const float *src = values;
+    int srcRows = nRows;
+    int srcCols = nCols;
+    int factor = 1;
+    while (srcRows > blockSize || srcCols > blockSize) {
+        int dstRows = (srcRows + 1) / 2;
+        int dstCols = (srcCols + 1) / 2;
+        float *dst = new float[dstRows * dstCols];
+        _build_overview_by_average(src, srcRows, srcCols, nodata, dst);
+        factor *= 2;
+        levels.push_back(dst);
+        levelRows.push_back(dstRows);
+        levelCols.push_back(dstCols);
+        factors.push_back(factor);
+        src = dst;
+        srcRows = dstRows;
+        srcCols = dstCols;
+    }
+    /// 2. Stage the full resolution data in a dataset supporting internal overviews, i.e., an in-memory
+    ///    dataset since GDAL 2.1, otherwise a temporary GeoTIFF next to the output file.
+    bool flag = false;
+    GDALDriver *poDriver = GetGDALDriverManager()->GetDriverByName("GTiff");
+#if GDAL_VERSION_NUM >= 2010000
+    GDALDriver *poStageDriver = GetGDALDriverManager()->GetDriverByName("MEM");
+    string stagefile = "";
+#else
+    GDALDriver *poStageDriver = poDriver;
+    string stagefile = filename + ".stage.tif";
+#endif /* GDAL_VERSION_NUM */
+    GDALDataset *poStageDS = nullptr;
+    if (nullptr != poDriver && nullptr != poStageDriver) {
+        poStageDS = poStageDriver->Create(stagefile.c_str(), nCols, nRows, 1, GDT_Float32, nullptr);
+    }
+    if (nullptr != poStageDS) {
+        double geoTrans[6];
+        _header_to_geotransform(header, geoTrans);
+        poStageDS->SetGeoTransform(geoTrans);
+        poStageDS->SetProjection(srs.c_str());
+        GDALRasterBand *poStageBand = poStageDS->GetRasterBand(1);
+        flag = nullptr != poStageBand;
+        if (flag) {
+            poStageBand->SetNoDataValue(nodata);
+            flag = CE_None == poStageBand->RasterIO(GF_Write, 0, 0, nCols, nRows, values,
+                                                  nCols, nRows, GDT_Float32, 0, 0);
+        }
+        /// 3. Create the overviews of the staged dataset and fill them with the pyramid built above,
+        ///    the resampled values of GDAL are overwritten, so the cheapest "NEAREST" is used.
+        if (flag && !factors.empty()) {
+            int bandList[1] = {1};
+            flag = CE_None == poStageDS->BuildOverviews("NEAREST", (int) factors.size(), &factors[0],
+                                                      1, bandList, GDALDummyProgress, nullptr);
+            flag = flag && poStageBand->GetOverviewCount() == (int) factors.size();
+        }
+        for (int i = 0; flag && i < (int) levels.size(); i++) {
+            GDALRasterBand *poOvrBand = poStageBand->GetOverview(i);
+            flag = nullptr != poOvrBand && poOvrBand->GetXSize() == levelCols[i] &&
+                poOvrBand->GetYSize() == levelRows[i] &&
+                CE_None == poOvrBand->RasterIO(GF_Write, 0, 0, levelCols[i], levelRows[i], levels[i],
+                                               levelCols[i], levelRows[i], GDT_Float32, 0, 0);
+            if (flag) poOvrBand->SetNoDataValue(nodata);
+        }
+        /// 4. Copy to tiled GeoTIFF together with the overviews, which writes all IFDs at the
+        ///    beginning, then the tiles from the coarsest overview to the full resolution data.
+        if (flag) {
+            char **papszOptions = nullptr;
+            papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+            papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", ValueToString(blockSize).c_str());
+            papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", ValueToString(blockSize).c_str());
+            papszOptions = CSLSetNameValue(papszOptions, "BIGTIFF", "IF_SAFER");
+            papszOptions = CSLSetNameValue(papszOptions, "COPY_SRC_OVERVIEWS", "YES");
+            DeleteExistedFile(filename);
+            GDALDataset *poDstDS = poDriver->CreateCopy(filename.c_str(), poStageDS, false, papszOptions,
+                                                        GDALDummyProgress, nullptr);
+            CSLDestroy(papszOptions);
+            flag = nullptr != poDstDS;
+            if (flag) GDALClose(poDstDS);
+        }
+        GDALClose(poStageDS);
+    }
+    if (!stagefile.empty()) DeleteExistedFile(stagefile);
+    for (auto it = levels.begin(); it != levels.end(); ++it) {
+        delete[] *it;
+    }
+    if (!flag) print_status("Write Cloud-Optimized GeoTIFF " + filename + " failed!");
+    return flag;
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::outputCOGFile(string filename, int blockSize /* = 256 */) {
+    if (blockSize <= 0 || blockSize % 16 != 0) {
+        print_status("The tile size of GeoTIFF must be a multiple of 16!");
+        return false;
+    }
+    if (!this->validate_raster_data()) return false;
+    filename = GetAbsolutePath(filename);
+    string prePath = GetPathFromFullName(filename);
+    if (StringMatch(prePath, "")) return false;
+    string coreName = GetCoreFileName(filename);
+    int nRows = int(m_headers.at(HEADER_RS_NROWS));
+    int nCols = int(m_headers.at(HEADER_RS_NCOLS));
+    float *rasterdata1D = new float[nRows * nCols];
+    bool outflag = true;
+    for (int lyr = 0; lyr < m_nLyrs && outflag; lyr++) {
+        string tmpfilename = prePath + coreName + "." + GTiffExtension;
+        if (m_is2DRaster) {
+            stringstream oss;
+            oss << prePath << coreName << "_" << (lyr + 1) << "." << GTiffExtension;
+            tmpfilename = oss.str();
+        }
+        this->_build_fullsize_layer_data(lyr, rasterdata1D);
+        outflag = this->_write_single_cog(tmpfilename, m_headers, m_srs, rasterdata1D, blockSize);
+    }
+    Release1DArray(rasterdata1D);
+    return outflag;
+}
+
+template<typename T, typename MaskT>
+shared_future<bool> clsRasterData<T, MaskT>::outputToFileAsync(clsRasterOutputQueue *queue, string filename) {
+    if (nullptr == queue || !this->validate_raster_data()) {
+        promise<bool> failed;
+        failed.set_value(false);
+        return failed.get_future().share();
+    }
+    shared_ptr<clsRasterData<T, MaskT> > snapshot(new clsRasterData<T, MaskT>(this));
+    return queue->submit([snapshot, filename]() { return snapshot->outputToFile(filename); });
 }
 
 #ifdef USE_MONGODB
 
 template<typename T, typename MaskT>
-void clsRasterData<T, MaskT>::outputToMongoDB(string filename, MongoGridFS *gfs) {
+shared_future<bool> clsRasterData<T, MaskT>::outputToMongoDBAsync(clsRasterOutputQueue *queue, string filename,
+                                                                  MongoGridFS *gfs,
+                                                                  bool compact /* = false */) {
+    if (nullptr == queue || nullptr == gfs || !this->validate_raster_data()) {
+        promise<bool> failed;
+        failed.set_value(false);
+        return failed.get_future().share();
+    }
+    shared_ptr<clsRasterData<T, MaskT> > snapshot(new clsRasterData<T, MaskT>(this));
+    return queue->submit([snapshot, filename, gfs, compact]() {
+        /// the existed file is removed, so the following check reflects this upload
+        gfs->removeFile(filename);
+        snapshot->outputToMongoDB(filename, gfs, compact);
+        bson_t *bmeta = gfs->getFileMetadata(filename);
+        if (nullptr == bmeta) return false;
+        bson_destroy(bmeta);
+        return true;
+    });
+}
+
+template<typename T, typename MaskT>
+vector<bool> clsRasterData<T, MaskT>::BatchOutputToMongoDB(mongoc_client_pool_t *pool,
+                                                           const string &dbname,
+                                                           const string &gfsname,
+                                                           const vector<clsRasterData<T, MaskT> *> &rasters,
+                                                           const vector<string> &remoteFilenames,
+                                                           bool compact /* = false */,
+                                                           int nThreads /* = 0 */,
+                                                           function<void(int, bool)> onCompleted /* = nullptr */) {
+    int nfiles = (int) rasters.size();
+    vector<char> written(nfiles, 0);  /// not vector<bool>, since elements are set by several threads
+    if (nullptr == pool || nfiles == 0 || (int) remoteFilenames.size() != nfiles) {
+        return vector<bool>(nfiles, false);
+    }
+    mutex completedmutex;
+    /// the remaining rasters are still taken if failed to get GridFS, so each one is reported once
+    _run_gridfs_workers(pool, dbname, gfsname, nfiles, nThreads, [&](int i, MongoGridFS *gfs) {
+        clsRasterData<T, MaskT> *rs = rasters[i];
+        if (nullptr != gfs && nullptr != rs && rs->validate_raster_data()) {
+            /// the existed file is removed, so the following check reflects this upload
+            gfs->removeFile(remoteFilenames[i]);
+            rs->outputToMongoDB(remoteFilenames[i], gfs, compact);
+            bson_t *bmeta = gfs->getFileMetadata(remoteFilenames[i]);
+            if (nullptr != bmeta) {
+                written[i] = 1;
+                bson_destroy(bmeta);
+            }
+        }
+        if (!written[i]) print_status("Failed to write " + remoteFilenames[i] + " into MongoDB!");
+        if (onCompleted) {
+            lock_guard<mutex> lock(completedmutex);
+            onCompleted(i, written[i] != 0);
+        }
+    });
+    return vector<bool>(written.begin(), written.end());
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::outputToMongoDB(string filename, MongoGridFS *gfs, bool compact /* = false */) {
+    if (compact) {
+        this->_write_compact_gridfs(filename, gfs);
+        return;
+    }
     /// 1. Is there need to calculate valid position index?
     int count;
     int **position;
@@ -1749,47 +5226,42 @@ void clsRasterData<T, MaskT>::outputToMongoDB(string filename, MongoGridFS *gfs)
         T *rasterdata1D = nullptr;
         datalength = nRows * nCols * m_nLyrs;
         Initialize1DArray(datalength, rasterdata1D, noDataValue);
-        int countindex = 0;
-        for (int i = 0; i < nRows; ++i) {
-            for (int j = 0; j < nCols; ++j) {
-                int rowcolindex = i * nCols + j;
-                int dataIndex = i * nCols * m_nLyrs + j * m_nLyrs;
-                if (outputdirectly) {
-                    for (int k = 0; k < m_nLyrs; k++) {
-                        rasterdata1D[dataIndex + k] = m_raster2DData[rowcolindex][k];
-                    }
-                    continue;
-                }
-                if (countindex < m_nCells && (position[countindex][0] == i && position[countindex][1] == j)) {
-                    for (int k = 0; k < m_nLyrs; k++) {
-                        rasterdata1D[dataIndex + k] = m_raster2DData[countindex][k];
-                    }
-                    countindex++;
-                }
+        /// pixel interleaved, or band interleaved (layer-major)
+        int cellstride = m_gfsBandInterleaved ? 1 : m_nLyrs;
+        int lyrstride = m_gfsBandInterleaved ? nRows * nCols : 1;
+        /// scatter valid cells in parallel, each cell is written by one thread
+        int ncells = outputdirectly ? nRows * nCols : m_nCells;
+#pragma omp parallel for
+        for (int i = 0; i < ncells; i++) {
+            int rowcolindex = outputdirectly ? i : position[i][0] * nCols + position[i][1];
+            int dataIndex = rowcolindex * cellstride;
+            for (int k = 0; k < m_nLyrs; k++) {
+                rasterdata1D[dataIndex + k * lyrstride] = this->_2d_value(i, k);
             }
         }
-        this->_write_stream_data_as_gridfs(gfs, filename, m_headers, m_srs, rasterdata1D, datalength);
+        if (m_gfsBandInterleaved) {
+            this->_write_stream_data_as_gridfs(gfs, filename, m_headers, m_srs, (const char *) rasterdata1D,
+                                               (size_t) datalength * sizeof(T), GridFSLayoutBand);
+        } else {
+            this->_write_stream_data_as_gridfs(gfs, filename, m_headers, m_srs, (const char *) rasterdata1D,
+                                               (size_t) datalength * sizeof(T));
+        }
         Release1DArray(rasterdata1D);
     } else {  /// 3.2 1D raster data
-        float *rasterdata1D = nullptr;
+        T *rasterdata1D = nullptr;
         datalength = nRows * nCols;
         if (outputdirectly) {
             rasterdata1D = m_rasterData;
         } else
             Initialize1DArray(datalength, rasterdata1D, noDataValue);
-        int validnum = 0;
         if (!outputdirectly) {
-            for (int i = 0; i < nRows; ++i) {
-                for (int j = 0; j < nCols; ++j) {
-                    int index = i * nCols + j;
-                    if (validnum < m_nCells && (position[validnum][0] == i && position[validnum][1] == j)) {
-                        rasterdata1D[index] = m_rasterData[validnum];
-                        validnum++;
-                    }
-                }
+#pragma omp parallel for
+            for (int i = 0; i < m_nCells; i++) {
+                rasterdata1D[position[i][0] * nCols + position[i][1]] = m_rasterData[i];
             }
         }
-        this->_write_stream_data_as_gridfs(gfs, filename, m_headers, m_srs, rasterdata1D, datalength);
+        this->_write_stream_data_as_gridfs(gfs, filename, m_headers, m_srs, (const char *) rasterdata1D,
+                                           (size_t) datalength * sizeof(T));
         if (outputdirectly) { rasterdata1D = nullptr; }
         else
             Release1DArray(rasterdata1D);
@@ -1801,30 +5273,165 @@ void clsRasterData<T, MaskT>::_write_stream_data_as_gridfs(MongoGridFS *gfs,
                                                            string filename,
                                                            map<string, double> &header,
                                                            string srs,
-                                                           T *values,
-                                                           size_t datalength) {
-    bson_t p = BSON_INITIALIZER;
-    for (map<string, double>::iterator iter = header.begin(); iter != header.end(); iter++) {
-        BSON_APPEND_DOUBLE(&p, iter->first.c_str(), iter->second);
+                                                           const char *payload,
+                                                           size_t bytes,
+                                                           string layout /* = "" */) {
+    /// data is stored in its native type, e.g., INT32 for int
+    _write_gridfs_payload(gfs, filename, header, srs, _get_raster_data_type<T>(), layout,
+                          payload, bytes, m_gfsCompression, m_gfsBlockSize);
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_write_compact_gridfs(string filename, MongoGridFS *gfs) {
+    int nCols = this->getCols();
+    int nRows = this->getRows();
+    /// 1. Valid cells, i.e., the stored positions, or the cells of which any layer is not NODATA
+    vector<int> valididx;  /// indexes of the full-sized array, only used if positions are not stored
+    int nvalid = m_nCells;
+    int nlyrs = m_is2DRaster ? m_nLyrs : 1;
+    if (nullptr == m_rasterPositionData && this->hasValidityMask()) {
+        int nwords = this->getValidityWordNumber();
+        vector<uint64_t> anyvalid(this->getValidityMask(1), this->getValidityMask(1) + nwords);
+        for (int lyr = 2; lyr <= nlyrs; lyr++) {
+            const uint64_t *words = this->getValidityMask(lyr);
+            for (int w = 0; w < nwords; w++) {
+                anyvalid[w] |= words[w];
+            }
+        }
+        _for_each_set_bit(anyvalid.empty() ? nullptr : &anyvalid[0], m_nCells, [&](int i) { valididx.emplace_back(i); });
+        nvalid = (int) valididx.size();
+    } else if (nullptr == m_rasterPositionData) {
+        for (int i = 0; i < nRows * nCols; i++) {
+            for (int lyr = 0; lyr < nlyrs; lyr++) {
+                T v = m_is2DRaster ? this->_2d_value(i, lyr) : m_rasterData[i];
+                if (FloatEqual(v, m_noDataValue)) continue;
+                valididx.emplace_back(i);
+                break;
+            }
+        }
+        nvalid = (int) valididx.size();
+    }
+    /// 2. Run-length positions, i.e., (row, start column, length) of consecutive valid cells in one row
+    vector<int32_t> runs;
+    const clsRasterSpanIndex *spans = this->getSpanIndex();
+    if (nullptr != spans) {  /// the spans are exactly the runs
+        runs.reserve((size_t) spans->getSpanNumber() * 3);
+        for (int row = 0; row < nRows; row++) {
+            for (int s = spans->getRowSpanBegin(row); s < spans->getRowSpanEnd(row); s++) {
+                runs.push_back(row);
+                runs.push_back(spans->getSpanColumn(s));
+                runs.push_back(spans->getSpanLength(s));
+            }
+        }
+    }
+    for (int i = 0; i < nvalid && nullptr == spans; i++) {
+        int row = nullptr == m_rasterPositionData ? valididx[i] / nCols : m_rasterPositionData[i][0];
+        int col = nullptr == m_rasterPositionData ? valididx[i] % nCols : m_rasterPositionData[i][1];
+        size_t n = runs.size();
+        if (n > 0 && runs[n - 3] == row && runs[n - 2] + runs[n - 1] == col) {
+            runs[n - 1]++;
+        } else {
+            runs.push_back(row);
+            runs.push_back(col);
+            runs.push_back(1);
+        }
+    }
+    int nruns = (int) runs.size() / 3;
+    /// 3. Payload, values start at an 8-byte aligned offset
+    size_t runsbytes = (runs.size() * sizeof(int32_t) + 7) / 8 * 8;
+    size_t buflength = runsbytes + (size_t) nvalid * m_nLyrs * sizeof(T);
+    char *buf = new char[buflength];
+    memset(buf, 0, runsbytes);
+    if (!runs.empty()) memcpy(buf, &runs[0], runs.size() * sizeof(int32_t));
+    T *values = (T *) (buf + runsbytes);
+#pragma omp parallel for
+    for (int i = 0; i < nvalid; i++) {
+        int idx = nullptr == m_rasterPositionData ? valididx[i] : i;
+        for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+            values[i * m_nLyrs + lyr] = m_is2DRaster ? this->_2d_value(idx, lyr) : m_rasterData[idx];
+        }
+    }
+    map<string, double> header(m_headers);
+    header[HEADER_RS_CELLSNUM] = nvalid;
+    header[HEADER_RS_RUNSNUM] = nruns;
+    this->_write_stream_data_as_gridfs(gfs, filename, header, m_srs, buf, buflength, GridFSLayoutCompact);
+    delete[] buf;
+}
+
+#endif /* USE_MONGODB */
+
+/************* Read functions ***************/
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::ReadFromFile(string filename, bool calcPositions /* = true */,
+                                           clsRasterData<MaskT> *mask /* = nullptr */,
+                                           bool useMaskExtent /* = true */,
+                                           T defalutValue /* = (T) NODATA_VALUE */) {
+    if (!_check_raster_files_exist(filename)) return false;
+    this->_initialize_raster_class();
+    return this->_construct_from_single_file(filename, calcPositions, mask, useMaskExtent, defalutValue);
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::ReadFromStorage(clsRasterStorage *storage, string name,
+                                              bool calcPositions /* = true */,
+                                              clsRasterData<MaskT> *mask /* = nullptr */,
+                                              bool useMaskExtent /* = true */,
+                                              T defalutValue /* = (T) NODATA_VALUE */) {
+    this->_initialize_read_function(name, calcPositions, mask, useMaskExtent, defalutValue);
+    /// 1. Get metadata
+    if (!storage->open(name, m_headers, m_srs)) {
+        print_status("Failed to open " + name + " from the storage!");
+        return false;
+    }
+    /// Copy the typed snapshot of clsRasterStorageMemory directly, if the data type and positions match
+    clsRasterStorageMemory *memory = dynamic_cast<clsRasterStorageMemory *>(storage);
+    if (nullptr != memory && nullptr == mask) {
+        shared_ptr<const StorageSnapshot> snapshot =
+            dynamic_pointer_cast<const StorageSnapshot>(memory->getHandle(name));
+        if (nullptr != snapshot && snapshot->m_raster.PositionsCalculated() == calcPositions) {
+            this->Copy(&snapshot->m_raster);
+            m_mask = nullptr;  /// the mask is neither owned nor kept alive by the storage, never restore it
+            this->_initialize_read_function(name, calcPositions, mask, useMaskExtent, defalutValue);
+            this->_check_default_value();
+            return true;
+        }
+    }
+    int nRows = (int) m_headers.at(HEADER_RS_NROWS);
+    int nCols = (int) m_headers.at(HEADER_RS_NCOLS);
+    m_nCells = nRows * nCols;
+    m_nLyrs = (int) m_headers.at(HEADER_RS_LAYERS);
+    m_noDataValue = (T) m_headers.at(HEADER_RS_NODATA);
+    m_headers[HEADER_RS_CELLSNUM] = -1.;
+    if (m_nCells <= 0 || m_nLyrs < 1) {
+        print_status("The headers of " + name + " are invalid!");
+        return false;
+    }
+    /// 2. Read layer by layer as full-sized data
+    if (m_nLyrs == 1) {
+        _initialize_1d_buffer(m_nCells, m_rasterData, m_noDataValue);
+        m_is2DRaster = false;
+    } else {
+        _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        m_is2DRaster = true;
+    }
+    vector<double> values(m_nCells);
+    for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+        if (!storage->readWindow(name, lyr + 1, 0, nRows, &values[0])) {
+            print_status("Failed to read the layer " + ValueToString(lyr + 1) + " of " + name + "!");
+            return false;
+        }
+#pragma omp parallel for
+        for (int i = 0; i < m_nCells; i++) {
+            if (m_is2DRaster) {
+                m_raster2DData[i][lyr] = (T) values[i];
+            } else {
+                m_rasterData[i] = (T) values[i];
+            }
+        }
     }
-    BSON_APPEND_UTF8(&p, HEADER_RS_SRS, srs.c_str());
-    char *buf = (char *) values;
-    size_t buflength = datalength * sizeof(T);
-    gfs->writeStreamData(filename, buf, buflength, &p);
-    bson_destroy(&p);
-}
-
-#endif /* USE_MONGODB */
-
-/************* Read functions ***************/
-template<typename T, typename MaskT>
-bool clsRasterData<T, MaskT>::ReadFromFile(string filename, bool calcPositions /* = true */,
-                                           clsRasterData<MaskT> *mask /* = nullptr */,
-                                           bool useMaskExtent /* = true */,
-                                           T defalutValue /* = (T) NODATA_VALUE */) {
-    if (!_check_raster_files_exist(filename)) return false;
-    this->_initialize_raster_class();
-    return this->_construct_from_single_file(filename, calcPositions, mask, useMaskExtent, defalutValue);
+    this->_check_default_value();
+    this->_mask_and_calculate_valid_positions();
+    return true;
 }
 
 #ifdef USE_MONGODB
@@ -1837,18 +5444,68 @@ bool clsRasterData<T, MaskT>::ReadFromMongoDB(MongoGridFS *gfs,
                                               bool useMaskExtent /* = true */,
                                               T defalutValue /* = (T) NODATA_VALUE */) {
     this->_initialize_read_function(filename, calcPositions, mask, useMaskExtent, defalutValue);
-    /// 1. Get stream data and metadata by file name
-    char *buf;
-    size_t length;
-    gfs->getStreamData(filename, buf, length);
+    /// 1. Get metadata by file name and retrieve raster header values
     bson_t *bmeta = gfs->getFileMetadata(filename);
-    /// 2. Retrieve raster header values
-    const char *RASTER_HEADERS[8] = {HEADER_RS_NCOLS, HEADER_RS_NROWS, HEADER_RS_XLL, HEADER_RS_YLL, HEADER_RS_CELLSIZE,
-                                     HEADER_RS_NODATA, HEADER_RS_LAYERS, HEADER_RS_CELLSNUM};
-    for (int i = 0; i < 8; i++) {
-        GetNumericFromBson(bmeta, RASTER_HEADERS[i], m_headers[RASTER_HEADERS[i]]);
+    if (nullptr == bmeta) {
+        print_status("Failed to read " + filename + " from MongoDB!");
+        return false;
+    }
+    GridFSRasterPayload payload;
+    _parse_gridfs_metadata(bmeta, m_headers, m_srs, payload);
+    bson_destroy(bmeta);
+    RasterDataType dtype = payload.dataType;
+    bool compact = StringMatch(payload.layout, GridFSLayoutCompact);
+    bool band = StringMatch(payload.layout, GridFSLayoutBand);
+    bool compressed = !payload.compressionKnown || payload.compression != RCP_None;
+    /// 2. Get stream data. The full-sized and uncompressed payload is streamed chunk by chunk
+    ///    into the raster data directly, otherwise, the whole payload is staged in memory.
+    ///    If the node-local cache is enabled, the decoded payload is read from or written to the cache.
+    bool staged = compact || compressed;
+    bool usecache = !_gridfs_cache_directory().empty();
+    bool cached = false;
+    string cachefile;
+    char *buf = nullptr;
+    size_t length = 0;
+    mongoc_gridfs_file_t *gfile = nullptr;
+    if (staged && !usecache) {
+        gfs->getStreamData(filename, buf, length);
+    } else {
+        gfile = gfs->getFile(filename);
+        if (nullptr != gfile) length = (size_t) mongoc_gridfs_file_get_length(gfile);
+    }
+    if (usecache && nullptr != gfile) {
+        cachefile = _gridfs_cache_filename(gfile);
+        cached = !cachefile.empty() && _read_gridfs_cache(cachefile, buf, length);
+        if (!cached) {
+            buf = new char[length];
+            if (length > 0 && !_read_gridfs_bytes(gfile, 0, length, buf)) {
+                delete[] buf;
+                buf = nullptr;
+            }
+        }
+        mongoc_gridfs_file_destroy(gfile);
+        gfile = nullptr;
+        staged = true;
+        if (cached) compressed = false;
+    }
+    if (nullptr == buf && nullptr == gfile) {
+        print_status("Failed to read " + filename + " from MongoDB!");
+        return false;
+    }
+    /// decompress blocks in parallel, the decoded payload is the same as the uncompressed one
+    if (compressed) {
+        char *rawbuf = payload.compressionKnown && payload.rawLength > 0 ? new char[payload.rawLength] : nullptr;
+        if (nullptr == rawbuf || !_decompress_blocks(payload.compression, buf, length, payload.blockSize,
+                                                     payload.rawLength, rawbuf)) {
+            print_status("Failed to decompress " + filename + ", the compression may be not supported!");
+            delete[] buf;
+            if (nullptr != rawbuf) delete[] rawbuf;
+            return false;
+        }
+        delete[] buf;
+        buf = rawbuf;
+        length = payload.rawLength;
     }
-    m_srs = GetStringFromBson(bmeta, HEADER_RS_SRS);
 
     int nRows = (int) m_headers.at(HEADER_RS_NROWS);
     int nCols = (int) m_headers.at(HEADER_RS_NCOLS);
@@ -1856,14 +5513,29 @@ bool clsRasterData<T, MaskT>::ReadFromMongoDB(MongoGridFS *gfs,
     m_noDataValue = (T) m_headers.at(HEADER_RS_NODATA);
     m_nLyrs = (int) m_headers.at(HEADER_RS_LAYERS);
 
-    /// TODO (by LJ), currently data stored in MongoDB is always float.
-    ///  I can not find an elegant way to make it templated.
-    assert(m_nCells == length / sizeof(float) / m_nLyrs);
-
     int validcount = -1;
     if (m_headers.find(HEADER_RS_CELLSNUM) != m_headers.end()) {
         validcount = (int) m_headers.at(HEADER_RS_CELLSNUM);
     }
+    size_t expectlength = (size_t) m_nCells * m_nLyrs * _get_raster_data_type_size(dtype);
+    if (compact) {
+        expectlength = ((size_t) payload.runsNumber * 3 * sizeof(int32_t) + 7) / 8 * 8 +
+            (size_t) validcount * m_nLyrs * _get_raster_data_type_size(dtype);
+    }
+    if (dtype == RDT_Unknown || m_nLyrs < 1 || (compact && validcount < 0) || length != expectlength) {
+        print_status("The data type or length of " + filename + " is inconsistent with the metadata!");
+        if (nullptr != buf) delete[] buf;
+        if (nullptr != gfile) mongoc_gridfs_file_destroy(gfile);
+        return false;
+    }
+    if (!cachefile.empty() && !cached) {
+        _write_gridfs_cache(cachefile, buf, length);
+    }
+    if (compact) {
+        this->_read_compact_gridfs(buf, dtype, payload.runsNumber, validcount);
+        delete[] buf;
+        return true;
+    }
     /// 3. Store data.
     /// check the valid values count and determine whether can read directly.
     bool reBuildData = true;
@@ -1871,76 +5543,322 @@ bool clsRasterData<T, MaskT>::ReadFromMongoDB(MongoGridFS *gfs,
         nullptr != m_mask && validcount == m_mask->getCellNumber()) {
         reBuildData = false;
         m_storePositions = false;
-        m_mask->getRasterPositionData(&m_nCells, &m_rasterPositionData);
+        this->_share_mask_positions();
     }
-    /// read data directly
-    if (m_nLyrs == 1) {
-        float *tmpdata = (float *) buf;
-        Initialize1DArray(m_nCells, m_rasterData, m_noDataValue);
+    this->_allocate_gridfs_data();
+    if (staged) {
+        /// convert to T from the stored type
+        int cursor = 0;
+        this->_store_gridfs_raw_chunk(buf, dtype, 0, nRows * nCols * m_nLyrs, band, reBuildData, cursor);
+        delete[] buf;
+    } else {
+        /// convert each chunk to T from the stored type as it arrives
+        bool streamed = this->_stream_gridfs_data(gfile, dtype, band, reBuildData);
+        mongoc_gridfs_file_destroy(gfile);
+        if (!streamed) {
+            print_status("Failed to read the stream data of " + filename + " from MongoDB!");
+            return false;
+        }
+    }
+    this->_check_default_value();
+    if (reBuildData) {
+        this->_mask_and_calculate_valid_positions();
+    }
+    return true;
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::ReadWindowFromMongoDB(MongoGridFS *gfs, string filename,
+                                                    int rowStart, int rowCount,
+                                                    vector<int> layers /* = vector<int>() */,
+                                                    bool calcPositions /* = true */,
+                                                    T defalutValue /* = (T) NODATA_VALUE */) {
+    this->_initialize_read_function(filename, calcPositions, nullptr, false, defalutValue);
+    /// 1. Fetch the window data, which keeps the interleave of payload
+    GridFSRasterPayload payload;
+    char *buf = nullptr;
+    if (!_read_gridfs_window(gfs, filename, rowStart, rowCount, layers, m_headers, m_srs, payload, buf)) {
+        return false;
+    }
+    int nRows = (int) m_headers.at(HEADER_RS_NROWS);
+    int nCols = (int) m_headers.at(HEADER_RS_NCOLS);
+    int nsel = (int) layers.size();
+    size_t wincells = (size_t) rowCount * nCols;
+    bool band = StringMatch(payload.layout, GridFSLayoutBand);
+    /// 2. Headers of the window, yll is the center of the lower left cell
+    m_headers[HEADER_RS_YLL] += (nRows - rowStart - rowCount) * m_headers.at(HEADER_RS_CELLSIZE);
+    m_headers[HEADER_RS_NROWS] = rowCount;
+    m_headers[HEADER_RS_LAYERS] = nsel;
+    m_headers[HEADER_RS_CELLSNUM] = -1.;
+    m_nCells = (int) wincells;
+    m_nLyrs = nsel;
+    m_noDataValue = (T) m_headers.at(HEADER_RS_NODATA);
+    /// 3. Store data
+    this->_allocate_gridfs_data();
+    int cursor = 0;
+    this->_store_gridfs_raw_chunk(buf, payload.dataType, 0, (int) wincells * nsel, band, true, cursor);
+    delete[] buf;
+    this->_check_default_value();
+    this->_mask_and_calculate_valid_positions();
+    return true;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_read_compact_gridfs(const char *buf, RasterDataType dtype,
+                                                   int nRuns, int nValidCells) {
+    int nCols = this->getCols();
+    this->releaseValidityMask();
+    /// 1. Decode run-length positions and the values of valid cells
+    const int32_t *runs = (const int32_t *) buf;
+    int **positions = nullptr;
+    _initialize_2d_buffer(nValidCells, 2, positions, 0);
+    int count = 0;
+    for (int r = 0; r < nRuns; r++) {
+        for (int k = 0; k < runs[r * 3 + 2] && count < nValidCells; k++) {
+            positions[count][0] = runs[r * 3];
+            positions[count][1] = runs[r * 3 + 1] + k;
+            count++;
+        }
+    }
+    T *values = nullptr;
+    _initialize_1d_buffer(nValidCells * m_nLyrs, values, m_noDataValue);
+    _convert_raster_data(buf + ((size_t) nRuns * 3 * sizeof(int32_t) + 7) / 8 * 8, dtype,
+                         nValidCells * m_nLyrs, values);
+    /// 2. Use the decoded positions directly if no re-masking is required, i.e., the positions are
+    ///    the same as the mask's on the same georeferenced grid, or no mask is used and the first layer of valid cells is not NODATA.
+    bool samewithmask = false;
+    if (nullptr != m_mask && m_calcPositions && m_useMaskExtent && m_mask->getCellNumber() == nValidCells &&
+        m_mask->getRows() == this->getRows() && m_mask->getCols() == nCols &&
+        FloatEqual(m_mask->getXllCenter(), this->getXllCenter()) &&
+        FloatEqual(m_mask->getYllCenter(), this->getYllCenter()) &&
+        FloatEqual(m_mask->getCellWidth(), this->getCellWidth())) {
+        int **maskpos = nullptr;
+        int masknum = -1;
+        m_mask->getRasterPositionData(&masknum, &maskpos);
+        samewithmask = nullptr != m_mask->getPositionIndex() &&
+            m_mask->getPositionIndex()->equals(nValidCells, positions);
+    }
+    bool usepositions = samewithmask;
+    if (nullptr == m_mask && m_calcPositions) {
+        usepositions = true;
+        for (int i = 0; i < nValidCells && usepositions; i++) {
+            usepositions = !FloatEqual(values[i * m_nLyrs], m_noDataValue);
+        }
+    }
+    m_is2DRaster = m_nLyrs > 1;
+    if (usepositions) {
+        m_nCells = nValidCells;
+        m_headers.at(HEADER_RS_CELLSNUM) = m_nCells;
+        if (samewithmask) {
+            _release_2d_buffer(positions);
+            this->_share_mask_positions();
+            m_storePositions = false;
+        } else {
+            this->_adopt_positions(positions);
+            m_storePositions = true;
+        }
+        if (m_is2DRaster) {
+            _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
 #pragma omp parallel for
-        for (int i = 0; i < m_nCells; i++) {
-            int tmpidx = i;
-            if (!reBuildData) tmpidx = m_rasterPositionData[i][0] * this->getCols() + m_rasterPositionData[i][1];
-            m_rasterData[i] = (T) tmpdata[tmpidx];
+            for (int i = 0; i < m_nCells; i++) {
+                for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+                    m_raster2DData[i][lyr] = values[i * m_nLyrs + lyr];
+                }
+            }
+            _release_aligned_buffer(values);
+        } else {
+            m_rasterData = values;
+        }
+        this->_check_default_value();
+        return;
+    }
+    /// 3. Otherwise, expand to the full-sized array, then mask and calculate positions as usual
+    T *fullvalues = nullptr;
+    Initialize1DArray(m_nCells * m_nLyrs, fullvalues, m_noDataValue);
+#pragma omp parallel for
+    for (int i = 0; i < nValidCells; i++) {
+        int idx = positions[i][0] * nCols + positions[i][1];
+        for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+            fullvalues[idx * m_nLyrs + lyr] = values[i * m_nLyrs + lyr];
         }
-        Release1DArray(tmpdata);
+    }
+    _release_2d_buffer(positions);
+    _release_aligned_buffer(values);
+    this->_set_position_index(nullptr);
+    m_headers.at(HEADER_RS_CELLSNUM) = m_nCells;
+    this->_store_gridfs_data(fullvalues, true);
+    Release1DArray(fullvalues);
+    this->_check_default_value();
+    this->_mask_and_calculate_valid_positions();
+}
+
+template<typename T, typename MaskT>
+template<typename TS>
+void clsRasterData<T, MaskT>::_store_gridfs_data(const TS *values, bool reBuildData) {
+    this->_allocate_gridfs_data();
+    int cursor = 0;
+    this->_store_gridfs_chunk(values, 0, this->getRows() * this->getCols() * m_nLyrs, m_nLyrs, 0,
+                              reBuildData, cursor);
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_allocate_gridfs_data() {
+    if (m_nLyrs == 1) {
+        _initialize_1d_buffer(m_nCells, m_rasterData, m_noDataValue);
         m_is2DRaster = false;
     } else {
-        float *tmpdata = (float *) buf;
-        Initialize2DArray(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        m_is2DRaster = true;
+    }
+}
+
+template<typename T, typename MaskT>
+template<typename TS>
+void clsRasterData<T, MaskT>::_store_gridfs_chunk(const TS *values, size_t first, int n, int nLyrs, int lyrOffset,
+                                                  bool reBuildData, int &cursor) {
+    if (reBuildData) {
 #pragma omp parallel for
-        for (int i = 0; i < m_nCells; i++) {
-            int tmpidx = i;
-            if (!reBuildData) tmpidx = m_rasterPositionData[i][0] * this->getCols() + m_rasterPositionData[i][1];
-            for (int j = 0; j < m_nLyrs; j++) {
-                int idx = tmpidx * m_nLyrs + j;
-                m_raster2DData[i][j] = (T) tmpdata[idx];
+        for (int i = 0; i < n; i++) {
+            size_t idx = first + i;
+            if (m_is2DRaster) {
+                m_raster2DData[idx / nLyrs][lyrOffset + idx % nLyrs] = (T) values[i];
+            } else {
+                m_rasterData[idx] = (T) values[i];
             }
         }
-        m_is2DRaster = true;
-        Release1DArray(tmpdata);
+        return;
     }
-    buf = nullptr;
-    this->_check_default_value();
-    if (reBuildData) {
-        this->_mask_and_calculate_valid_positions();
+    /// gather the valid cells of the mask covered by this chunk,
+    /// the positions are sorted, so the cursor moves forward only.
+    int nCols = this->getCols();
+    size_t last = first + n;
+    int start = cursor;
+    int end = cursor;
+    while (end < m_nCells &&
+        (size_t) (m_rasterPositionData[end][0] * nCols + m_rasterPositionData[end][1]) * nLyrs < last) {
+        end++;
+    }
+#pragma omp parallel for
+    for (int i = start; i < end; i++) {
+        size_t base = (size_t) (m_rasterPositionData[i][0] * nCols + m_rasterPositionData[i][1]) * nLyrs;
+        for (int lyr = 0; lyr < nLyrs; lyr++) {
+            size_t idx = base + lyr;
+            if (idx < first || idx >= last) continue;
+            if (m_is2DRaster) {
+                m_raster2DData[i][lyrOffset + lyr] = (T) values[idx - first];
+            } else {
+                m_rasterData[i] = (T) values[idx - first];
+            }
+        }
+    }
+    /// the layers of the last cell may be continued in the next chunk
+    cursor = end;
+    if (end > start &&
+        (size_t) (m_rasterPositionData[end - 1][0] * nCols + m_rasterPositionData[end - 1][1] + 1) * nLyrs > last) {
+        cursor = end - 1;
+    }
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::_store_gridfs_raw_chunk(const char *values, RasterDataType dtype, size_t first, int n,
+                                                  bool band, bool reBuildData, int &cursor) {
+    int esize = _get_raster_data_type_size(dtype);
+    if (esize == 0) return false;
+    size_t ncells = (size_t) this->getRows() * this->getCols();
+    while (n > 0) {
+        /// the band interleaved payload is stored layer by layer, each of which is a 1-layer payload
+        int nlyrs = band ? 1 : m_nLyrs;
+        int lyr = band ? (int) (first / ncells) : 0;
+        size_t segfirst = band ? first - lyr * ncells : first;
+        int m = band && segfirst + n > ncells ? (int) (ncells - segfirst) : n;
+        switch (dtype) {
+            case RDT_UInt8:
+                this->_store_gridfs_chunk((const uint8_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_Int8:
+                this->_store_gridfs_chunk((const int8_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_UInt16:
+                this->_store_gridfs_chunk((const uint16_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_Int16:
+                this->_store_gridfs_chunk((const int16_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_UInt32:
+                this->_store_gridfs_chunk((const uint32_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_Int32:
+                this->_store_gridfs_chunk((const int32_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_UInt64:
+                this->_store_gridfs_chunk((const uint64_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_Int64:
+                this->_store_gridfs_chunk((const int64_t *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            case RDT_Double:
+                this->_store_gridfs_chunk((const double *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+            default:
+                this->_store_gridfs_chunk((const float *) values, segfirst, m, nlyrs, lyr, reBuildData, cursor);
+                break;
+        }
+        if (band && segfirst + m == ncells) cursor = 0;  /// next layer
+        values += (size_t) m * esize;
+        first += m;
+        n -= m;
     }
     return true;
 }
 
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::_stream_gridfs_data(mongoc_gridfs_file_t *gfile, RasterDataType dtype,
+                                                  bool band, bool reBuildData) {
+    size_t total = (size_t) this->getRows() * this->getCols() * m_nLyrs;
+    size_t esize = (size_t) _get_raster_data_type_size(dtype);
+    if (esize == 0) return false;
+    char *chunk = new char[GridFSStreamBufferSize];
+    size_t carry = 0;  /// bytes of the element split between two reads
+    size_t first = 0;
+    int cursor = 0;
+    while (first < total) {
+        mongoc_iovec_t iov;
+        iov.iov_base = chunk + carry;
+        iov.iov_len = GridFSStreamBufferSize - carry;
+        ssize_t nread = mongoc_gridfs_file_readv(gfile, &iov, 1, 0, 0);
+        if (nread <= 0) break;
+        size_t bytes = carry + (size_t) nread;
+        int n = (int) (bytes / esize);
+        if (first + n > total) n = (int) (total - first);
+        this->_store_gridfs_raw_chunk(chunk, dtype, first, n, band, reBuildData, cursor);
+        first += n;
+        carry = bytes - n * esize;
+        if (carry > 0) memmove(chunk, chunk + n * esize, carry);
+    }
+    delete[] chunk;
+    return first == total;
+}
+
 #endif /* USE_MONGODB */
 
 template<typename T, typename MaskT>
 bool clsRasterData<T, MaskT>::_read_asc_file(string ascFileName, map<string, double> *header, T **values) {
     StatusMessage(("Read " + ascFileName + "...").c_str());
     ifstream rasterFile(ascFileName.c_str());
-    string tmp, xlls, ylls;
-    T noData;
     double tempFloat;
-    int rows, cols;
     map<string, double> tmpheader;
     /// read header
-    rasterFile >> tmp >> cols;
-    tmpheader.insert(make_pair(HEADER_RS_NCOLS, double(cols)));
-    rasterFile >> tmp >> rows;
-    tmpheader.insert(make_pair(HEADER_RS_NROWS, double(rows)));
-    rasterFile >> xlls >> tempFloat;
-    tmpheader.insert(make_pair(HEADER_RS_XLL, tempFloat));
-    rasterFile >> ylls >> tempFloat;
-    tmpheader.insert(make_pair(HEADER_RS_YLL, tempFloat));
-    rasterFile >> tmp >> tempFloat;
-    tmpheader.insert(make_pair(HEADER_RS_CELLSIZE, tempFloat));
-    rasterFile >> tmp >> noData;
-    tmpheader.insert(make_pair(HEADER_RS_NODATA, noData));
-    m_noDataValue = noData;
-    /// default is center, if corner, then:
-    if (StringMatch(xlls, "XLLCORNER")) tmpheader.at(HEADER_RS_XLL) += 0.5 * tmpheader.at(HEADER_RS_CELLSIZE);
-    if (StringMatch(ylls, "YLLCORNER")) tmpheader.at(HEADER_RS_YLL) += 0.5 * tmpheader.at(HEADER_RS_CELLSIZE);
-
+    if (!rasterFile.is_open() || !_read_asc_headers(rasterFile, tmpheader)) {
+        print_status("Failed to read the headers of " + ascFileName + "!");
+        return false;
+    }
+    int rows = int(tmpheader.at(HEADER_RS_NROWS));
+    int cols = int(tmpheader.at(HEADER_RS_NCOLS));
+    m_noDataValue = (T) tmpheader.at(HEADER_RS_NODATA);
     tmpheader.insert(make_pair(HEADER_RS_LAYERS, 1.));
     tmpheader.insert(make_pair(HEADER_RS_CELLSNUM, -1.));
     /// get all raster values (i.e., include NODATA_VALUE, m_excludeNODATA = False)
-    T *tmprasterdata = new T[rows * cols];
+    T *tmprasterdata = _allocate_aligned_buffer<T>((size_t) rows * cols);
     for (int i = 0; i < rows; ++i) {
         for (int j = 0; j < cols; ++j) {
             rasterFile >> tempFloat;
@@ -1973,10 +5891,7 @@ bool clsRasterData<T, MaskT>::_read_raster_file_by_gdal(string filename, map<str
     m_noDataValue = (T) poBand->GetNoDataValue();
     double adfGeoTransform[6];
     poDataset->GetGeoTransform(adfGeoTransform);
-    tmpheader.insert(make_pair(HEADER_RS_CELLSIZE, adfGeoTransform[1]));
-    tmpheader.insert(make_pair(HEADER_RS_XLL, adfGeoTransform[0] + 0.5 * tmpheader.at(HEADER_RS_CELLSIZE)));
-    tmpheader.insert(make_pair(HEADER_RS_YLL,
-                               adfGeoTransform[3] + (tmpheader.at(HEADER_RS_NROWS) - 0.5) * adfGeoTransform[5]));
+    _geotransform_to_header(adfGeoTransform, nRows, tmpheader);
     tmpheader.insert(make_pair(HEADER_RS_LAYERS, 1.));
     tmpheader.insert(make_pair(HEADER_RS_CELLSNUM, -1.));
     string tmpsrs = string(poDataset->GetProjectionRef());
@@ -1985,7 +5900,7 @@ bool clsRasterData<T, MaskT>::_read_raster_file_by_gdal(string filename, map<str
     if (m_nCells < 0) { /// if m_nCells has been assigned
         m_nCells = fullsize_nCells;
     }
-    T *tmprasterdata = new T[fullsize_nCells];
+    T *tmprasterdata = _allocate_aligned_buffer<T>((size_t) fullsize_nCells);
     GDALDataType dataType = poBand->GetRasterDataType();
     char *char_data = nullptr;
     unsigned char *uchar_data = nullptr;
@@ -2078,20 +5993,146 @@ clsRasterData<T, MaskT>::clsRasterData(clsRasterData<T, MaskT> *another) {
 }
 
 template<typename T, typename MaskT>
-void clsRasterData<T, MaskT>::Copy(const clsRasterData<T, MaskT> *orgraster) {
-    if (m_is2DRaster && nullptr != m_raster2DData && m_nCells > 0) {
-        Release2DArray(m_nCells, m_raster2DData);
+clsRasterData<T, MaskT>::clsRasterData(clsRasterData<T, MaskT> &&another) {
+    this->_initialize_raster_class();
+    this->swap(another);
+}
+
+template<typename T, typename MaskT>
+clsRasterData<T, MaskT> &clsRasterData<T, MaskT>::operator=(clsRasterData<T, MaskT> &&another) {
+    if (this != &another) {
+        clsRasterData<T, MaskT> moved(std::move(another));
+        this->swap(moved);  /// the original data is released together with moved
+    }
+    return *this;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::swap(clsRasterData<T, MaskT> &another) NOEXCEPT {
+    if (this == &another) return;
+    std::swap(m_nCells, another.m_nCells);
+    std::swap(m_nLyrs, another.m_nLyrs);
+    std::swap(m_noDataValue, another.m_noDataValue);
+    std::swap(m_defaultValue, another.m_defaultValue);
+    m_filePathName.swap(another.m_filePathName);
+    m_coreFileName.swap(another.m_coreFileName);
+    m_srs.swap(another.m_srs);
+    std::swap(m_rasterData, another.m_rasterData);
+    std::swap(m_alignedData, another.m_alignedData);
+    std::swap(m_raster2DData, another.m_raster2DData);
+    std::swap(m_contiguous2D, another.m_contiguous2D);
+    std::swap(m_layout, another.m_layout);
+    std::swap(m_rasterPositionData, another.m_rasterPositionData);
+    m_positionIndex.swap(another.m_positionIndex);
+    m_headers.swap(another.m_headers);
+    m_statsMap.swap(another.m_statsMap);
+    m_statsMap2D.swap(another.m_statsMap2D);
+    std::swap(m_mask, another.m_mask);
+    std::swap(m_initialized, another.m_initialized);
+    std::swap(m_is2DRaster, another.m_is2DRaster);
+    std::swap(m_calcPositions, another.m_calcPositions);
+    std::swap(m_storePositions, another.m_storePositions);
+    std::swap(m_useMaskExtent, another.m_useMaskExtent);
+    std::swap(m_statisticsCalculated, another.m_statisticsCalculated);
+    std::swap(m_tileSize, another.m_tileSize);
+    std::swap(m_nOutputThreads, another.m_nOutputThreads);
+    m_dirtyTiles.swap(another.m_dirtyTiles);
+    std::swap(m_gfsCompression, another.m_gfsCompression);
+    std::swap(m_gfsBlockSize, another.m_gfsBlockSize);
+    std::swap(m_gfsBandInterleaved, another.m_gfsBandInterleaved);
+    m_validityMask.swap(another.m_validityMask);
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_release_2d_data(int nCells) {
+    if (nullptr == m_raster2DData) return;
+    if (m_contiguous2D) {
+        _release_2d_buffer(m_raster2DData);
+    } else {
+        Release2DArray(m_layout == RL_LayerMajor ? m_nLyrs : nCells, m_raster2DData);
     }
-    if (!m_is2DRaster && nullptr != m_rasterData) {
+    m_contiguous2D = true;
+    m_layout = RL_CellMajor;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_release_1d_data() {
+    if (nullptr == m_rasterData) return;
+    if (m_alignedData) {
+        _release_aligned_buffer(m_rasterData);
+    } else {
         Release1DArray(m_rasterData);
     }
-    if (nullptr != m_rasterPositionData) {
-        Release2DArray(2, m_rasterPositionData);
+    m_alignedData = true;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_set_position_index(const shared_ptr<clsRasterPositionIndex> &index) {
+    m_positionIndex = index;
+    m_rasterPositionData = nullptr != index ? index->getPositions() : nullptr;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_adopt_positions(int **positions) {
+    this->_set_position_index(make_shared<clsRasterPositionIndex>(this->getRows(), m_nCells, positions));
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_share_mask_positions() {
+    int **maskpos = nullptr;
+    m_mask->getRasterPositionData(&m_nCells, &maskpos);  /// calculated if necessary
+    this->_set_position_index(m_mask->getPositionIndex());
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::transposeLayout(RasterLayout layout, bool padLayers /* = false */) {
+    if (!m_is2DRaster || nullptr == m_raster2DData) return true;
+    int ncells = m_nCells;
+    int nlyrs = m_nLyrs;
+    int stride = layout == RL_LayerMajor && padLayers ? _aligned_length<T>(ncells) : ncells;
+    if (layout == m_layout && (layout == RL_CellMajor || stride == this->getLayerStride())) return true;
+    T **src = m_raster2DData;
+    T **transposed = nullptr;
+    if (layout == RL_LayerMajor) {
+        _initialize_2d_buffer(nlyrs, ncells, transposed, m_noDataValue, stride);
+        for (int lyr = 0; lyr < nlyrs; lyr++) {
+            T *plane = transposed[lyr];
+#pragma omp parallel for
+            for (int i = 0; i < ncells; i++) {
+                plane[i] = this->_2d_value(i, lyr);
+            }
+        }
+    } else {
+        _initialize_2d_buffer(ncells, nlyrs, transposed, m_noDataValue);
+#pragma omp parallel for
+        for (int i = 0; i < ncells; i++) {
+            for (int lyr = 0; lyr < nlyrs; lyr++) {
+                transposed[i][lyr] = src[lyr][i];
+            }
+        }
     }
-    if (m_statisticsCalculated) {
+    this->_release_2d_data(m_nCells);
+    m_raster2DData = transposed;
+    m_contiguous2D = true;
+    m_layout = layout;
+    return true;
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::_release_raster_data() {
+    if (m_is2DRaster) this->_release_2d_data(m_nCells);
+    if (!m_is2DRaster) this->_release_1d_data();
+    this->_set_position_index(nullptr);
+    this->releaseValidityMask();
+    if (m_is2DRaster && m_statisticsCalculated) {
         releaseStatsMap2D();
         m_statisticsCalculated = false;
     }
+}
+
+template<typename T, typename MaskT>
+void clsRasterData<T, MaskT>::Copy(const clsRasterData<T, MaskT> *orgraster) {
+    this->_release_raster_data();
     this->_initialize_raster_class();
     m_filePathName = orgraster->getFilePath();
     m_coreFileName = orgraster->getCoreName();
@@ -2099,20 +6140,35 @@ void clsRasterData<T, MaskT>::Copy(const clsRasterData<T, MaskT> *orgraster) {
     m_nLyrs = orgraster->getLayers();
     m_noDataValue = orgraster->getNoDataValue();
     m_defaultValue = orgraster->getDefaultValue();
+    m_srs = orgraster->getSRSString();
     if (orgraster->is2DRaster()) {
         m_is2DRaster = true;
-        Initialize2DArray(m_nCells, m_nLyrs, m_raster2DData, orgraster->get2DRasterDataPointer());
+        m_layout = orgraster->getRasterLayout();
+        if (m_layout == RL_LayerMajor) {
+            _initialize_2d_buffer(m_nLyrs, m_nCells, m_raster2DData, orgraster->get2DRasterDataPointer(),
+                                  orgraster->getLayerStride());
+        } else {
+            _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, orgraster->get2DRasterDataPointer());
+        }
     } else {
         m_rasterData = nullptr;
-        Initialize1DArray(m_nCells, m_rasterData, orgraster->getRasterDataPointer());
+        _initialize_1d_buffer(m_nCells, m_rasterData, orgraster->getRasterDataPointer());
     }
     m_mask = orgraster->getMask();
+    m_nOutputThreads = orgraster->getOutputThreadNumber();
+    m_gfsCompression = orgraster->getGridFSCompression();
+    m_gfsBlockSize = orgraster->getGridFSBlockSize();
+    m_gfsBandInterleaved = orgraster->GridFSBandInterleaved();
     m_calcPositions = orgraster->PositionsCalculated();
-    if (m_calcPositions) {
-        m_storePositions = true;
-        Initialize2DArray(m_nCells, 2, m_rasterPositionData, orgraster->getRasterPositionDataPointer());
-    }
+    /// the position index, either calculated or borrowed from the mask layer, is shared
+    m_storePositions = orgraster->PositionsAllocated();
+    this->_set_position_index(orgraster->getPositionIndex());
     m_useMaskExtent = orgraster->MaskExtented();
+    if (orgraster->hasValidityMask()) {
+        int nwords = orgraster->getValidityWordNumber();
+        int nlyrs = m_is2DRaster ? m_nLyrs : 1;
+        m_validityMask.assign(orgraster->getValidityMask(1), orgraster->getValidityMask(1) + (size_t) nlyrs * nwords);
+    }
     m_statisticsCalculated = orgraster->StatisticsCalculated();
     if (m_statisticsCalculated) {
         if (m_is2DRaster) {
@@ -2133,14 +6189,234 @@ void clsRasterData<T, MaskT>::Copy(const clsRasterData<T, MaskT> *orgraster) {
     this->copyHeader(orgraster->getRasterHeader());
 }
 
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::saveState(string filename) {
+    if (!this->validate_raster_data()) return false;
+    ofstream ofs(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!ofs.is_open()) {
+        print_status("Open file " + filename + " failed!");
+        return false;
+    }
+    /// 1. Identification
+    ofs.write(RasterStateMagic, 8);
+    int version = RasterStateVersion;
+    ofs.write((const char *) &version, sizeof(int));
+    int typesize[2] = {(int) _get_raster_data_type<T>(), (int) sizeof(T)};  /// portable among compilers
+    ofs.write((const char *) typesize, sizeof(typesize));
+    /// 2. Headers, SRS, names, flags, and scalars
+    int nheaders = (int) m_headers.size();
+    ofs.write((const char *) &nheaders, sizeof(int));
+    for (auto iter = m_headers.begin(); iter != m_headers.end(); iter++) {
+        _write_binary_string(ofs, iter->first);
+        ofs.write((const char *) &iter->second, sizeof(double));
+    }
+    _write_binary_string(ofs, m_srs);
+    _write_binary_string(ofs, m_filePathName);
+    _write_binary_string(ofs, m_coreFileName);
+    bool haspositions = nullptr != m_rasterPositionData;
+    char flags[6] = {m_is2DRaster, m_calcPositions, m_storePositions, m_useMaskExtent,
+                     m_statisticsCalculated, haspositions};
+    ofs.write(flags, 6);
+    ofs.write((const char *) &m_nCells, sizeof(int));
+    ofs.write((const char *) &m_nLyrs, sizeof(int));
+    ofs.write((const char *) &m_noDataValue, sizeof(T));
+    ofs.write((const char *) &m_defaultValue, sizeof(T));
+    /// 3. Raster data
+    if (m_is2DRaster && m_layout == RL_LayerMajor) {  // the state file is always cell-major
+        vector<T> cellvalues(m_nLyrs);
+        for (int i = 0; i < m_nCells; i++) {
+            for (int lyr = 0; lyr < m_nLyrs; lyr++) {
+                cellvalues[lyr] = m_raster2DData[lyr][i];
+            }
+            ofs.write((const char *) &cellvalues[0], sizeof(T) * m_nLyrs);
+        }
+    } else if (m_is2DRaster) {
+        for (int i = 0; i < m_nCells; i++) {
+            ofs.write((const char *) m_raster2DData[i], sizeof(T) * m_nLyrs);
+        }
+    } else {
+        ofs.write((const char *) m_rasterData, sizeof(T) * m_nCells);
+    }
+    /// 4. Positions of valid cells, including the ones borrowed from the mask
+    if (haspositions) {
+        for (int i = 0; i < m_nCells; i++) {
+            ofs.write((const char *) m_rasterPositionData[i], sizeof(int) * 2);
+        }
+    }
+    /// 5. Cached statistics
+    if (m_statisticsCalculated) {
+        if (m_is2DRaster) {
+            int nstats = (int) m_statsMap2D.size();
+            ofs.write((const char *) &nstats, sizeof(int));
+            for (auto iter = m_statsMap2D.begin(); iter != m_statsMap2D.end(); iter++) {
+                _write_binary_string(ofs, iter->first);
+                ofs.write((const char *) iter->second, sizeof(double) * m_nLyrs);
+            }
+        } else {
+            int nstats = (int) m_statsMap.size();
+            ofs.write((const char *) &nstats, sizeof(int));
+            for (auto iter = m_statsMap.begin(); iter != m_statsMap.end(); iter++) {
+                _write_binary_string(ofs, iter->first);
+                ofs.write((const char *) &iter->second, sizeof(double));
+            }
+        }
+    }
+    bool flag = !ofs.fail();
+    ofs.close();
+    if (!flag) print_status("Write state into " + filename + " failed!");
+    return flag;
+}
+
+template<typename T, typename MaskT>
+bool clsRasterData<T, MaskT>::loadState(string filename, clsRasterData<MaskT> *mask /* = nullptr */) {
+    ifstream ifs(filename.c_str(), ios::in | ios::binary);
+    if (!ifs.is_open()) {
+        print_status("Open file " + filename + " failed!");
+        return false;
+    }
+    /// 1. Identification
+    char magic[8];
+    int version = -1;
+    int typesize[2] = {(int) RDT_Unknown, 0};  /// RasterDataType and sizeof(T)
+    ifs.read(magic, 8);
+    ifs.read((char *) &version, sizeof(int));
+    ifs.read((char *) typesize, sizeof(typesize));
+    if (!ifs || strncmp(magic, RasterStateMagic, 8) != 0 || version != RasterStateVersion) {
+        print_status(filename + " is not a valid raster state file!");
+        return false;
+    }
+    if (typesize[0] != (int) _get_raster_data_type<T>() || typesize[1] != (int) sizeof(T)) {
+        print_status("The data type of " + filename + " is inconsistent with the raster!");
+        return false;
+    }
+    this->_release_raster_data();
+    this->_initialize_raster_class();
+    /// 2. Headers, SRS, names, flags, and scalars
+    int nheaders = 0;
+    ifs.read((char *) &nheaders, sizeof(int));
+    for (int i = 0; i < nheaders && ifs; i++) {
+        string key;
+        double value = NODATA_VALUE;
+        if (!_read_binary_string(ifs, key)) break;
+        ifs.read((char *) &value, sizeof(double));
+        m_headers[key] = value;
+    }
+    _read_binary_string(ifs, m_srs);
+    _read_binary_string(ifs, m_filePathName);
+    _read_binary_string(ifs, m_coreFileName);
+    char flags[6] = {0, 0, 0, 0, 0, 0};
+    ifs.read(flags, 6);
+    ifs.read((char *) &m_nCells, sizeof(int));
+    ifs.read((char *) &m_nLyrs, sizeof(int));
+    ifs.read((char *) &m_noDataValue, sizeof(T));
+    ifs.read((char *) &m_defaultValue, sizeof(T));
+    if (!ifs || m_nCells <= 0 || m_nLyrs <= 0) {
+        print_status("Read state from " + filename + " failed!");
+        this->_initialize_raster_class();
+        return false;
+    }
+    m_is2DRaster = flags[0] != 0;
+    m_calcPositions = flags[1] != 0;
+    m_useMaskExtent = flags[3] != 0;
+    bool statscalculated = flags[4] != 0;
+    bool haspositions = flags[5] != 0;
+    /// the raster data and positions must be within the file before allocating, e.g., truncated file
+    uint64_t databytes = (uint64_t) m_nCells * (uint64_t) m_nLyrs * sizeof(T);
+    if (haspositions) databytes += (uint64_t) m_nCells * 2 * sizeof(int);
+    if (databytes > _remaining_stream_bytes(ifs)) {
+        print_status("Read state from " + filename + " failed, the file is truncated or corrupted!");
+        this->_initialize_raster_class();
+        return false;
+    }
+    /// 3. Raster data
+    if (m_is2DRaster) {
+        _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        for (int i = 0; i < m_nCells; i++) {
+            ifs.read((char *) m_raster2DData[i], sizeof(T) * m_nLyrs);
+        }
+    } else {
+        _initialize_1d_buffer(m_nCells, m_rasterData, m_noDataValue);
+        ifs.read((char *) m_rasterData, sizeof(T) * m_nCells);
+    }
+    /// 4. Positions of valid cells, borrowed from the mask if possible
+    m_mask = mask;
+    if (haspositions) {
+        int **positions = nullptr;
+        _initialize_2d_buffer(m_nCells, 2, positions, 0);
+        for (int i = 0; i < m_nCells; i++) {
+            ifs.read((char *) positions[i], sizeof(int) * 2);
+        }
+        if (flags[2] == 0 && nullptr != mask && nullptr != mask->getPositionIndex() &&
+            mask->getPositionIndex()->equals(m_nCells, positions)) {
+            _release_2d_buffer(positions);
+            this->_set_position_index(mask->getPositionIndex());
+            m_storePositions = false;
+        } else {
+            this->_adopt_positions(positions);
+            m_storePositions = true;
+        }
+    }
+    /// 5. Cached statistics
+    if (statscalculated) {
+        int nstats = 0;
+        ifs.read((char *) &nstats, sizeof(int));
+        if (m_is2DRaster) m_statsMap2D.clear();  /// initialized with nullptr
+        for (int i = 0; i < nstats && ifs; i++) {
+            string key;
+            if (!_read_binary_string(ifs, key)) break;
+            if (m_is2DRaster) {
+                double *values = nullptr;
+                Initialize1DArray(m_nLyrs, values, 0.);
+                ifs.read((char *) values, sizeof(double) * m_nLyrs);
+                m_statsMap2D[key] = values;
+            } else {
+                ifs.read((char *) &m_statsMap[key], sizeof(double));
+            }
+        }
+        m_statisticsCalculated = true;
+    }
+    if (ifs.fail()) {
+        print_status("Read state from " + filename + " failed!");
+        this->_release_raster_data();
+        this->_initialize_raster_class();
+        return false;
+    }
+    return true;
+}
+
 template<typename T, typename MaskT>
 void clsRasterData<T, MaskT>::replaceNoData(T replacedv) {
+    if (this->hasValidityMask() && this->validate_raster_data()) {  /// visit the NODATA cells only
+        int nwords = this->getValidityWordNumber();
+        int nlyrs = m_is2DRaster ? m_nLyrs : 1;
+        bool stillnodata = FloatEqual(replacedv, m_noDataValue);
+        for (int lyr = 0; lyr < nlyrs; lyr++) {
+            uint64_t *words = &m_validityMask[(size_t) lyr * nwords];
+#pragma omp parallel for
+            for (int w = 0; w < nwords; w++) {
+                int nbits = m_nCells - w * 64 < 64 ? m_nCells - w * 64 : 64;
+                _for_each_clear_bit(words + w, nbits, [&](int b) {
+                    int i = w * 64 + b;
+                    if (m_is2DRaster) {
+                        this->_2d_value(i, lyr) = replacedv;
+                    } else {
+                        m_rasterData[i] = replacedv;
+                    }
+                    this->_mark_dirty_cell(i, lyr);
+                });
+                if (!stillnodata) words[w] = _bit_word_mask(m_nCells, w);
+            }
+        }
+        return;
+    }
     if (m_is2DRaster && nullptr != m_raster2DData) {
 #pragma omp parallel for
         for (int i = 0; i < m_nCells; i++) {
             for (int lyr = 0; lyr < m_nLyrs; lyr++) {
-                if (FloatEqual(m_raster2DData[i][lyr], m_noDataValue)) {
-                    m_raster2DData[i][lyr] = replacedv;
+                T &v = this->_2d_value(i, lyr);
+                if (FloatEqual(v, m_noDataValue)) {
+                    v = replacedv;
+                    this->_mark_dirty_cell(i, lyr);
                 }
             }
         }
@@ -2149,6 +6425,7 @@ void clsRasterData<T, MaskT>::replaceNoData(T replacedv) {
         for (int i = 0; i < m_nCells; i++) {
             if (FloatEqual(m_rasterData[i], m_noDataValue)) {
                 m_rasterData[i] = replacedv;
+                this->_mark_dirty_cell(i, 0);
             }
         }
     }
@@ -2160,25 +6437,28 @@ void clsRasterData<T, MaskT>::reclassify(map<int, T> reclassMap) {
 #pragma omp parallel for
         for (int i = 0; i < m_nCells; i++) {
             for (int lyr = 0; lyr < m_nLyrs; lyr++) {
-                map<int, float>::iterator iter = reclassMap.find((int) m_raster2DData[i][lyr]);
-                if (iter != reclassMap.end()) {
-                    m_raster2DData[i][lyr] = iter->second;
-                } else {
-                    m_raster2DData[i][lyr] = m_noDataValue;
+                T &v = this->_2d_value(i, lyr);
+                typename map<int, T>::iterator iter = reclassMap.find((int) v);
+                T newv = iter != reclassMap.end() ? iter->second : m_noDataValue;
+                if (!FloatEqual(newv, v)) {
+                    v = newv;
+                    this->_mark_dirty_cell(i, lyr);
                 }
             }
         }
     } else if (nullptr != m_rasterData) {
 #pragma omp parallel for
         for (int i = 0; i < m_nCells; i++) {
-            map<int, float>::iterator iter = reclassMap.find((int) m_rasterData[i]);
-            if (iter != reclassMap.end()) {
-                m_rasterData[i] = iter->second;
-            } else {
-                m_rasterData[i] = m_noDataValue;
+            typename map<int, T>::iterator iter = reclassMap.find((int) m_rasterData[i]);
+            T newv = iter != reclassMap.end() ? iter->second : m_noDataValue;
+            if (!FloatEqual(newv, m_rasterData[i])) {
+                m_rasterData[i] = newv;
+                this->_mark_dirty_cell(i, 0);
             }
         }
     }
+    /// unmatched values become NODATA, so refresh the validity bitmask if built
+    if (this->hasValidityMask()) this->buildValidityMask();
 }
 
 /************* Utility functions ***************/
@@ -2226,6 +6506,10 @@ void clsRasterData<T, MaskT>::copyHeader(const map<string, double> &refers) {
 
 template<typename T, typename MaskT>
 void clsRasterData<T, MaskT>::_calculate_valid_positions_from_grid_data() {
+    /// rebuilding works on cell-major data, the original layout is restored at the end
+    RasterLayout layout = m_layout;
+    if (!this->transposeLayout(RL_CellMajor)) return;
+    this->releaseValidityMask();
     int oldcellnumber = m_nCells;
     /// initial vectors
     vector<T> values;
@@ -2268,16 +6552,15 @@ void clsRasterData<T, MaskT>::_calculate_valid_positions_from_grid_data() {
     m_nCells = (int) values.size();
     m_headers.at(HEADER_RS_CELLSNUM) = m_nCells;
     if (m_is2DRaster) {
-        Release2DArray(oldcellnumber, m_raster2DData);
-        Initialize2DArray(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        this->_release_2d_data(oldcellnumber);
+        _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
     } else {
-        Release1DArray(m_rasterData);
-        Initialize1DArray(m_nCells, m_rasterData, m_noDataValue);
+        this->_release_1d_data();
+        _initialize_1d_buffer(m_nCells, m_rasterData, m_noDataValue);
     }
 
-    /// m_rasterPositionData is nullptr till now.
-    //m_rasterPositionData = new int *[m_nCells];
-    Initialize2DArray(m_nCells, 2, m_rasterPositionData, 0);
+    int **positions = nullptr;
+    _initialize_2d_buffer(m_nCells, 2, positions, 0);
     m_storePositions = true;
 #pragma omp parallel for
     for (int i = 0; i < m_nCells; ++i) {
@@ -2291,15 +6574,17 @@ void clsRasterData<T, MaskT>::_calculate_valid_positions_from_grid_data() {
         } else {
             m_rasterData[i] = values.at(i);
         }
-        //m_rasterPositionData[i] = new int[2];
-        m_rasterPositionData[i][0] = positionRows.at(i);
-        m_rasterPositionData[i][1] = positionCols.at(i);
+        positions[i][0] = positionRows.at(i);
+        positions[i][1] = positionCols.at(i);
     }
+    this->_adopt_positions(positions);
     m_calcPositions = true;
+    this->transposeLayout(layout);
 }
 
 template<typename T, typename MaskT>
 void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
+    this->releaseValidityMask();
     int oldcellnumber = m_nCells;
     if (nullptr == m_mask) {
         if (m_calcPositions) {
@@ -2321,8 +6606,6 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
     int nValidMaskNumber;
     int **validPosition = nullptr;
     int maskRows = m_mask->getRows();
-    int maskCols = m_mask->getCols();
-    int maskCells = maskRows * maskCols;
     /// Get the position data from mask
     m_mask->getRasterPositionData(&nValidMaskNumber, &validPosition);
     /// calculate the interect extent between mask and the raster data
@@ -2393,8 +6676,6 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
     assert(values.size() == positionRows.size());
     assert(values.size() == positionCols.size());
 
-    if (!m_mask->PositionsCalculated()) Release2DArray(maskCells, validPosition);
-
     /// 2. Handing the header information
     /// Is the valid grid extent same as the mask data?
     bool sameExtentWithMask = true;
@@ -2459,7 +6740,7 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
     /// 3.1 Determine the m_nCells, and whether to allocate new position data space
     bool store_fullsize_array = false;
     if ((m_useMaskExtent || sameExtentWithMask) && m_calcPositions) {
-        m_mask->getRasterPositionData(&m_nCells, &m_rasterPositionData);
+        this->_share_mask_positions();
         m_storePositions = false;
     } else if ((!m_useMaskExtent && !sameExtentWithMask && !m_calcPositions) ||
         ((m_useMaskExtent || sameExtentWithMask) && !m_calcPositions)) {
@@ -2467,6 +6748,7 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
         m_nCells = this->getCols() * this->getRows();
         store_fullsize_array = true;
         m_storePositions = false;
+        this->_set_position_index(nullptr);
     } else {  // reCalculate raster positions data and store
         m_storePositions = true;
         m_nCells = (int) values.size();
@@ -2477,13 +6759,14 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
     ///     raster array and positions data array (if necessary)
     assert(this->validate_raster_data());
     if (m_is2DRaster && nullptr != m_raster2DData) {  // multiple layers
-        Release2DArray(oldcellnumber, m_raster2DData);
-        Initialize2DArray(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
+        this->_release_2d_data(oldcellnumber);
+        _initialize_2d_buffer(m_nCells, m_nLyrs, m_raster2DData, m_noDataValue);
     } else {  // single layer
-        Release1DArray(m_rasterData);
-        Initialize1DArray(m_nCells, m_rasterData, m_noDataValue);
+        this->_release_1d_data();
+        _initialize_1d_buffer(m_nCells, m_rasterData, m_noDataValue);
     }
-    if (m_storePositions) Initialize2DArray(m_nCells, 2, m_rasterPositionData, 0);
+    int **positions = nullptr;
+    if (m_storePositions) _initialize_2d_buffer(m_nCells, 2, positions, 0);
 
     /// 3.3 Loop the masked raster values
     int ncols = (int) m_headers.at(HEADER_RS_NCOLS);
@@ -2493,8 +6776,8 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
             synthesisIdx = positionRows.at(k) * ncols + positionCols.at(k);
         } else if (m_storePositions && !FloatEqual(values.at(k), m_noDataValue)) {
             synthesisIdx++;
-            m_rasterPositionData[synthesisIdx][0] = positionRows.at(k);
-            m_rasterPositionData[synthesisIdx][1] = positionCols.at(k);
+            positions[synthesisIdx][0] = positionRows.at(k);
+            positions[synthesisIdx][1] = positionCols.at(k);
         } else {
             synthesisIdx++;
         }
@@ -2509,6 +6792,13 @@ void clsRasterData<T, MaskT>::_mask_and_calculate_valid_positions() {
             m_rasterData[synthesisIdx] = values.at(k);
         }
     }
+    if (m_storePositions) this->_adopt_positions(positions);
+}
+
+//! Exchange two rasters in O(1), \sa clsRasterData::swap
+template<typename T, typename MaskT>
+inline void swap(clsRasterData<T, MaskT> &a, clsRasterData<T, MaskT> &b) NOEXCEPT {
+    a.swap(b);
 }
 
 #endif /* CLS_RASTER_DATA */
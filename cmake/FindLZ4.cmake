@@ -0,0 +1,42 @@
+# Read-Only variables:
+#  LZ4_FOUND - system has the LZ4 library
+#  LZ4_INCLUDE_DIR - the LZ4 include directory
+#  LZ4_LIBRARIES - The libraries needed to use LZ4
+
+if (UNIX)
+    find_package(PkgConfig QUIET)
+    pkg_check_modules(_LZ4 QUIET liblz4)
+endif ()
+
+find_path(LZ4_INCLUDE_DIR
+        NAMES
+        lz4.h
+        HINTS
+        CMAKE_PREFIX_PATH
+        $ENV{LZ4_ROOT_DIR}
+        ${_LZ4_INCLUDEDIR}
+        PATH_SUFFIXES
+        include
+        )
+
+find_library(LZ4_LIBRARY
+        NAMES
+        lz4
+        liblz4
+        HINTS
+        CMAKE_PREFIX_PATH
+        $ENV{LZ4_ROOT_DIR}
+        ${_LZ4_LIBDIR}
+        PATH_SUFFIXES
+        lib
+        )
+mark_as_advanced(LZ4_LIBRARY)
+set(LZ4_LIBRARIES ${LZ4_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LZ4 "Could NOT find LZ4"
+        LZ4_LIBRARIES
+        LZ4_INCLUDE_DIR
+        )
+
+mark_as_advanced(LZ4_INCLUDE_DIR LZ4_LIBRARIES)
@@ -72,4 +72,10 @@ ENDIF()
 IF (WITH_MONGOC)
   INCLUDE(FindBson)
   INCLUDE(FindMongoC)
-ENDIF()
\ No newline at end of file
+ENDIF()
+
+### LZ4 and zstd, optional block compression of GridFS payloads.
+IF (WITH_MONGOC)
+  INCLUDE(FindLZ4)
+  INCLUDE(FindZstd)
+ENDIF()
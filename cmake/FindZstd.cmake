@@ -0,0 +1,42 @@
+# Read-Only variables:
+#  ZSTD_FOUND - system has the zstd library
+#  ZSTD_INCLUDE_DIR - the zstd include directory
+#  ZSTD_LIBRARIES - The libraries needed to use zstd
+
+if (UNIX)
+    find_package(PkgConfig QUIET)
+    pkg_check_modules(_ZSTD QUIET libzstd)
+endif ()
+
+find_path(ZSTD_INCLUDE_DIR
+        NAMES
+        zstd.h
+        HINTS
+        CMAKE_PREFIX_PATH
+        $ENV{ZSTD_ROOT_DIR}
+        ${_ZSTD_INCLUDEDIR}
+        PATH_SUFFIXES
+        include
+        )
+
+find_library(ZSTD_LIBRARY
+        NAMES
+        zstd
+        libzstd
+        HINTS
+        CMAKE_PREFIX_PATH
+        $ENV{ZSTD_ROOT_DIR}
+        ${_ZSTD_LIBDIR}
+        PATH_SUFFIXES
+        lib
+        )
+mark_as_advanced(ZSTD_LIBRARY)
+set(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(ZSTD "Could NOT find ZSTD"
+        ZSTD_LIBRARIES
+        ZSTD_INCLUDE_DIR
+        )
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARIES)
@@ -78,6 +78,7 @@ TEST_P(clsRasterDataTestNoPosNoMask, RasterIO) {
     ASSERT_TRUE(rs->validate_raster_data());
 
     EXPECT_NE(nullptr, rs->getRasterDataPointer());  // m_rasterData
+    EXPECT_EQ(0u, (size_t) rs->getRasterDataPointer() % RasterDataAlignment);
     EXPECT_EQ(nullptr, rs->get2DRasterDataPointer());  // m_raster2DData
     EXPECT_EQ(nullptr, rs->getRasterPositionDataPointer());  // m_rasterPositionData
 
@@ -171,6 +172,23 @@ TEST_P(clsRasterDataTestNoPosNoMask, RasterIO) {
     EXPECT_EQ(32, rs->getPosition(4.05f, 37.95f));
     EXPECT_EQ(32, rs->getPosition(5.95f, 36.05f));
 
+    /** Validity bitmask **/
+    EXPECT_FALSE(rs->hasValidityMask());
+    EXPECT_EQ(nullptr, rs->getValidityMask());
+    rs->buildValidityMask();
+    ASSERT_TRUE(rs->hasValidityMask());
+    EXPECT_EQ(10, rs->getValidityWordNumber());  // 600 cells
+    EXPECT_EQ(nullptr, rs->getValidityMask(2));
+    const uint64_t *validbits = rs->getValidityMask();
+    ASSERT_NE(nullptr, validbits);
+    int nvalidbits = 0;
+    for (int i = 0; i < 600; i++) {
+        bool valid = ((validbits[i / 64] >> (i % 64)) & 1) == 1;
+        EXPECT_EQ(!FloatEqual(rs->getValueByIndex(i), -9999.f), valid);
+        if (valid) nvalidbits++;
+    }
+    EXPECT_EQ(541, nvalidbits);
+
     /** Set value **/
     // Set core file name
     string newcorename = corename + "_1D-nopos-nomask";
@@ -189,6 +207,23 @@ TEST_P(clsRasterDataTestNoPosNoMask, RasterIO) {
     EXPECT_FLOAT_EQ(9.17659779f, rs->getAverage());
     EXPECT_FLOAT_EQ(5.63006041f, rs->getSTD());
     EXPECT_FLOAT_EQ(97.684f, rs->getRange());
+    // the validity bitmask is maintained by setValue and consulted by statistics
+    EXPECT_EQ(1u, validbits[0] & 1u);
+    EXPECT_EQ(542, rs->getValidNumber());
+
+    // replace NoData through the validity bitmask
+    clsRasterData<float> *filledrs = new clsRasterData<float>(rs);
+    ASSERT_TRUE(filledrs->hasValidityMask());
+    int nodataidx = 0;
+    while (nodataidx < 600 && !FloatEqual(filledrs->getValueByIndex(nodataidx), -9999.f)) nodataidx++;
+    ASSERT_LT(nodataidx, 600);
+    filledrs->replaceNoData(0.f);
+    EXPECT_FLOAT_EQ(0.f, filledrs->getValueByIndex(nodataidx));
+    EXPECT_FLOAT_EQ(9.9f, filledrs->getValueByIndex(1));
+    filledrs->updateStatistics();
+    EXPECT_EQ(600, filledrs->getValidNumber());
+    EXPECT_FLOAT_EQ(0.f, filledrs->getMinimum());
+    delete filledrs;
 
     /** Output to new file **/
     string oldfullname = rs->getFilePath();
@@ -32,6 +32,71 @@ string tif_file = apppath + "../data/" + corename + ".tif";
 const char *asc_file_chars = asc_file.c_str();
 const char *tif_file_chars = tif_file.c_str();
 
+/*!
+ * Check the Cloud-Optimized GeoTIFF layout of a classic TIFF file, i.e., all IFDs are located before
+ * the tile data, and the tiles of coarser overviews are located before the finer ones.
+ * \param[out] nIFDs Number of IFDs, i.e., the full resolution image and its overviews
+ */
+bool IsCOGLayout(const string &filename, int *nIFDs) {
+    *nIFDs = 0;
+    ifstream ifs(filename.c_str(), ios::binary);
+    unsigned char buf[12];
+    if (!ifs.read((char *) buf, 8)) return false;
+    bool le = buf[0] == 'I';
+    auto u16 = [le](const unsigned char *p) -> uint32_t {
+        return le ? p[0] | p[1] << 8 : p[0] << 8 | p[1];
+    };
+    auto u32 = [le](const unsigned char *p) -> uint32_t {
+        return le ? p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24
+                  : (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+    };
+    if (u16(buf + 2) != 42) return false;  // BigTIFF is not expected for small rasters
+    vector<uint32_t> ifds;
+    vector<uint32_t> firsttiles;
+    vector<uint32_t> lasttiles;
+    uint32_t ifd = u32(buf + 4);
+    while (ifd != 0 && ifds.size() < 64) {
+        ifds.push_back(ifd);
+        ifs.seekg(ifd);
+        if (!ifs.read((char *) buf, 2)) return false;
+        int nentries = u16(buf);
+        uint32_t first = UINT32_MAX;
+        uint32_t last = 0;
+        for (int e = 0; e < nentries; e++) {
+            ifs.seekg(ifd + 2 + e * 12);
+            if (!ifs.read((char *) buf, 12)) return false;
+            if (u16(buf) != 324 && u16(buf) != 273) continue;  // TileOffsets or StripOffsets
+            uint32_t count = u32(buf + 4);
+            int size = u16(buf + 2) == 3 ? 2 : 4;  // SHORT or LONG
+            vector<unsigned char> offsets(count * size);
+            if (count * size <= 4) {
+                memcpy(&offsets[0], buf + 8, count * size);
+            } else {
+                ifs.seekg(u32(buf + 8));
+                if (!ifs.read((char *) &offsets[0], count * size)) return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t off = size == 2 ? u16(&offsets[i * 2]) : u32(&offsets[i * 4]);
+                if (off == 0) continue;  // sparse tile
+                first = min(first, off);
+                last = max(last, off);
+            }
+        }
+        firsttiles.push_back(first);
+        lasttiles.push_back(last);
+        ifs.seekg(ifd + 2 + nentries * 12);
+        if (!ifs.read((char *) buf, 4)) return false;
+        ifd = u32(buf);
+    }
+    *nIFDs = (int) ifds.size();
+    uint32_t lastifd = *max_element(ifds.begin(), ifds.end());
+    for (size_t i = 0; i < ifds.size(); i++) {
+        if (firsttiles[i] <= lastifd) return false;
+        if (i > 0 && lasttiles[i] >= firsttiles[i - 1]) return false;
+    }
+    return true;
+}
+
 //Inside the test body, fixture constructor, SetUp(), and TearDown() you
 //can refer to the test parameter by GetParam().  In this case, the test
 //parameter is file name (const char*) which we call in fixture's SetUp()
@@ -214,6 +279,38 @@ TEST_P(clsRasterDataTestPosNoMask, RasterIO) {
         newcorename + "_mongo." + GetSuffix(oldfullname);
     EXPECT_TRUE(rs->outputToFile(newfullname));
     EXPECT_TRUE(FileExists(newfullname));
+    // output to Cloud-Optimized GeoTIFF with internal overviews
+    string cogfullname = GetPathFromFullName(oldfullname) + "result" + SEP +
+        newcorename + "_" + GetSuffix(oldfullname) + "_cog." + GTiffExtension;
+    EXPECT_FALSE(rs->outputCOGFile(cogfullname, 100));  // tile size must be a multiple of 16
+    EXPECT_TRUE(rs->outputCOGFile(cogfullname, 16));
+    EXPECT_TRUE(FileExists(cogfullname));
+    GDALDataset *cogds = (GDALDataset *) GDALOpen(cogfullname.c_str(), GA_ReadOnly);
+    ASSERT_NE(nullptr, cogds);
+    ASSERT_EQ(1, cogds->GetRasterBand(1)->GetOverviewCount());  // 30 * 20 -> 15 * 10
+    EXPECT_EQ(15, cogds->GetRasterBand(1)->GetOverview(0)->GetXSize());
+    EXPECT_EQ(10, cogds->GetRasterBand(1)->GetOverview(0)->GetYSize());
+    GDALClose(cogds);
+    int nifds = 0;
+    EXPECT_TRUE(IsCOGLayout(cogfullname, &nifds));
+    EXPECT_EQ(2, nifds);
+    EXPECT_FALSE(FileExists(cogfullname + ".stage.tif"));  // temporary staging file of GDAL < 2.1
+    // only rewrite the modified tiles of the tiled GeoTIFF
+    string tiledfullname = GetPathFromFullName(oldfullname) + "result" + SEP +
+        newcorename + "_" + GetSuffix(oldfullname) + "_tiled." + GTiffExtension;
+    EXPECT_FALSE(rs->updateFile(tiledfullname));  // dirty tiles are not tracked
+    EXPECT_FALSE(rs->setDirtyTileTracking(100));
+    EXPECT_TRUE(rs->setDirtyTileTracking(16));
+    EXPECT_TRUE(rs->DirtyTilesTracked());
+    EXPECT_TRUE(rs->outputFileByGDAL(tiledfullname));
+    EXPECT_EQ(0, rs->getDirtyTileNumber());
+    rs->setValue(2, 4, 8.06f);
+    EXPECT_EQ(1, rs->getDirtyTileNumber());
+    EXPECT_FALSE(rs->updateFile(newfullname));  // ASC can not be updated in place
+    EXPECT_TRUE(rs->updateFile(tiledfullname));
+    EXPECT_EQ(0, rs->getDirtyTileNumber());
+    EXPECT_TRUE(rs->setDirtyTileTracking(0));
+    EXPECT_FALSE(rs->DirtyTilesTracked());
 
 #ifdef USE_MONGODB
     /** MongoDB I/O test **/
@@ -235,6 +332,122 @@ TEST_P(clsRasterDataTestPosNoMask, RasterIO) {
     // output to asc/tif file for comparison
     EXPECT_TRUE(mongors->outputToFile(newfullname4mongo));
     EXPECT_TRUE(FileExists(newfullname4mongo));
+    // data is stored in its native type
+    bson_t *bmeta = gfs->getFileMetadata(gfsfilename);
+    EXPECT_EQ("FLOAT32", GetStringFromBson(bmeta, HEADER_RS_DATATYPE));
+    bson_destroy(bmeta);
+    clsRasterData<int> *intrs = clsRasterData<int>::Init(gfs, gfsfilename.c_str());
+    ASSERT_NE(nullptr, intrs);
+    EXPECT_EQ(541, intrs->getCellNumber());
+    EXPECT_EQ(8, intrs->getValue(2, 4));  // 8.06
+    string intgfsfilename = gfsfilename + "_int";
+    gfs->removeFile(intgfsfilename);
+    intrs->outputToMongoDB(intgfsfilename, gfs);
+    bmeta = gfs->getFileMetadata(intgfsfilename);
+    EXPECT_EQ("INT32", GetStringFromBson(bmeta, HEADER_RS_DATATYPE));
+    bson_destroy(bmeta);
+    clsRasterData<double> *dblrs = clsRasterData<double>::Init(gfs, intgfsfilename.c_str());
+    ASSERT_NE(nullptr, dblrs);
+    EXPECT_EQ(541, dblrs->getCellNumber());
+    EXPECT_DOUBLE_EQ(8., dblrs->getValue(2, 4));
+    delete dblrs;
+    delete intrs;
+    // compact layout, i.e., valid cells and run-length positions
+    string compactgfsname = gfsfilename + "_compact";
+    gfs->removeFile(compactgfsname);
+    rs->outputToMongoDB(compactgfsname, gfs, true);
+    bmeta = gfs->getFileMetadata(compactgfsname);
+    EXPECT_EQ("COMPACT", GetStringFromBson(bmeta, HEADER_RS_LAYOUT));
+    bson_destroy(bmeta);
+    clsRasterData<float> *compactrs = clsRasterData<float>::Init(gfs, compactgfsname.c_str());
+    ASSERT_NE(nullptr, compactrs);
+    EXPECT_EQ(541, compactrs->getCellNumber());
+    EXPECT_TRUE(compactrs->PositionsAllocated());
+    EXPECT_EQ(541, compactrs->getValidNumber());
+    rs->updateStatistics();
+    EXPECT_FLOAT_EQ(rs->getAverage(), compactrs->getAverage());
+    EXPECT_FLOAT_EQ(rs->getValue(2, 4), compactrs->getValue(2, 4));
+    delete compactrs;
+    // compact layout of raster without positions
+    clsRasterData<float> *fullrs = clsRasterData<float>::Init(rs->getFilePath(), false);
+    ASSERT_NE(nullptr, fullrs);
+    fullrs->outputToMongoDB(compactgfsname, gfs, true);
+    compactrs = clsRasterData<float>::Init(gfs, compactgfsname.c_str(), false);
+    ASSERT_NE(nullptr, compactrs);
+    EXPECT_EQ(fullrs->getCellNumber(), compactrs->getCellNumber());
+    EXPECT_FALSE(compactrs->PositionsCalculated());
+    EXPECT_FLOAT_EQ(fullrs->getAverage(), compactrs->getAverage());
+    delete compactrs;
+    delete fullrs;
+    // block compressed payload, which is decoded transparently
+    EXPECT_FALSE(rs->setGridFSCompression(RCP_None, 0));
+    RasterCompression codecs[2] = {RCP_LZ4, RCP_Zstd};
+    for (int i = 0; i < 2; i++) {
+        if (!RasterCompressionSupported(codecs[i])) {
+            EXPECT_FALSE(rs->setGridFSCompression(codecs[i]));
+            continue;
+        }
+        EXPECT_TRUE(rs->setGridFSCompression(codecs[i], 1000));  // multiple blocks
+        string compressedname = gfsfilename + "_" + RasterCompressionToString(codecs[i]);
+        gfs->removeFile(compressedname);
+        rs->outputToMongoDB(compressedname, gfs);
+        bmeta = gfs->getFileMetadata(compressedname);
+        EXPECT_EQ(RasterCompressionToString(codecs[i]), GetStringFromBson(bmeta, HEADER_RS_COMPRESSION));
+        bson_destroy(bmeta);
+        clsRasterData<float> *compressedrs = clsRasterData<float>::Init(gfs, compressedname.c_str());
+        ASSERT_NE(nullptr, compressedrs);
+        EXPECT_EQ(541, compressedrs->getCellNumber());
+        EXPECT_FLOAT_EQ(rs->getAverage(), compressedrs->getAverage());
+        EXPECT_FLOAT_EQ(rs->getValue(2, 4), compressedrs->getValue(2, 4));
+        delete compressedrs;
+    }
+    EXPECT_TRUE(rs->setGridFSCompression(RCP_None));
+    // node-local cache keyed by the content hash of GridFS file
+    string cachedir = GetPathFromFullName(oldfullname) + "result" + SEP + "gfscache";
+    EXPECT_FALSE(SetGridFSCacheDirectory(cachedir + SEP + "noExistDir"));
+    CleanDirectory(cachedir);
+    EXPECT_TRUE(SetGridFSCacheDirectory(cachedir));
+    string cachedname = gfsfilename + "_cached";
+    gfs->removeFile(cachedname);
+    rs->outputToMongoDB(cachedname, gfs);
+    for (int i = 0; i < 2; i++) {  // populate the cache, then read from the cache
+        clsRasterData<float> *cachedrs = clsRasterData<float>::Init(gfs, cachedname.c_str());
+        ASSERT_NE(nullptr, cachedrs);
+        EXPECT_EQ(541, cachedrs->getCellNumber());
+        EXPECT_FLOAT_EQ(rs->getAverage(), cachedrs->getAverage());
+        EXPECT_FLOAT_EQ(rs->getValue(2, 4), cachedrs->getValue(2, 4));
+        delete cachedrs;
+    }
+    // the overwritten file has a new content hash
+    float oldvalue = rs->getValue(2, 4);
+    rs->setValue(2, 4, oldvalue + 1.f);
+    gfs->removeFile(cachedname);
+    rs->outputToMongoDB(cachedname, gfs);
+    clsRasterData<float> *cachedrs = clsRasterData<float>::Init(gfs, cachedname.c_str());
+    ASSERT_NE(nullptr, cachedrs);
+    EXPECT_FLOAT_EQ(oldvalue + 1.f, cachedrs->getValue(2, 4));
+    delete cachedrs;
+    rs->setValue(2, 4, oldvalue);
+    // the bytes of payload must match the cache file, which is checked before allocating
+    string fakecache = cachedir + SEP + "fake." + GridFSCacheExtension;
+    char payload[16] = "cached payload";
+    ASSERT_TRUE(_write_gridfs_cache(fakecache, payload, 16));
+    char *cachedbuf = nullptr;
+    size_t cachedlength = 0;
+    ASSERT_TRUE(_read_gridfs_cache(fakecache, cachedbuf, cachedlength));
+    EXPECT_EQ(16u, cachedlength);
+    EXPECT_STREQ(payload, cachedbuf);
+    delete[] cachedbuf;
+    cachedbuf = nullptr;
+    ofstream fakefs(fakecache.c_str(), ios::out | ios::binary | ios::trunc);
+    uint64_t fakebytes = (uint64_t) 1 << 40;  // corrupted length
+    fakefs.write(GridFSCacheMagic, 8);
+    fakefs.write((const char *) &fakebytes, sizeof(uint64_t));
+    fakefs.write(payload, 16);
+    fakefs.close();
+    EXPECT_FALSE(_read_gridfs_cache(fakecache, cachedbuf, cachedlength));
+    EXPECT_EQ(nullptr, cachedbuf);
+    EXPECT_TRUE(SetGridFSCacheDirectory(""));
 #endif
 }
 INSTANTIATE_TEST_CASE_P(SingleLayer, clsRasterDataTestPosNoMask,
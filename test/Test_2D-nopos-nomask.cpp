@@ -233,6 +233,34 @@ TEST(clsRasterDataTestMultiNoPosNoMask, RasterIO) {
         newcorename + "." + GetSuffix(oldfullname);
     EXPECT_TRUE(rs->outputToFile(newfullname));
 
+#ifdef USE_MONGODB
+    /** Compact layout keeps the cells of which any layer is valid **/
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    string compactgfsname = newcorename + "_compact";
+    float lyr1value = rs->getValue(2, 4, 1);
+    float lyr2value = rs->getValue(2, 4, 2);
+    ASSERT_FALSE(FloatEqual(lyr2value, -9999.f));
+    rs->setValue(2, 4, -9999.f, 1);
+    for (int withbits = 0; withbits < 2; withbits++) {
+        if (withbits) rs->buildValidityMask();
+        gfs->removeFile(compactgfsname);
+        rs->outputToMongoDB(compactgfsname, gfs, true);
+        clsRasterData<float> *compactrs = clsRasterData<float>::Init(gfs, compactgfsname.c_str(), false);
+        ASSERT_NE(nullptr, compactrs);
+        EXPECT_EQ(600, compactrs->getCellNumber());
+        EXPECT_FLOAT_EQ(-9999.f, compactrs->getValue(2, 4, 1));
+        EXPECT_FLOAT_EQ(lyr2value, compactrs->getValue(2, 4, 2));
+        EXPECT_FLOAT_EQ(rs->getValue(2, 4, 3), compactrs->getValue(2, 4, 3));
+        delete compactrs;
+    }
+    gfs->removeFile(compactgfsname);
+    rs->releaseValidityMask();
+    rs->setValue(2, 4, lyr1value, 1);
+    delete gfs;
+#endif
+
     /* Get position data, which will be calculated if not existed */
     ncells = -1;
     int **positions = nullptr;
@@ -93,7 +93,7 @@ protected:
 };
 
 // Since each TEST_P will invoke SetUp() and TearDown()
-// once, we put all tests in once test case. by lj.
+// once, the basic I/O is tested in RasterIO, and each feature in its own test case.
 TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, RasterIO) {
     /// 1. Test members after constructing.
     EXPECT_EQ(73, rs->getDataLength());  // m_nCells
@@ -232,6 +232,458 @@ TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, RasterIO) {
     delete copyrs;
 }
 
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, ContiguousBuffers) {
+    // 2D raster data is one contiguous cell-major buffer
+    ASSERT_NE(nullptr, rs->get2DRasterDataBuffer());
+    EXPECT_EQ(rs->get2DRasterDataBuffer(), rs->get2DRasterDataPointer()[0]);
+    EXPECT_EQ(rs->get2DRasterDataBuffer() + 72 * 3, rs->get2DRasterDataPointer()[72]);
+    EXPECT_EQ(0u, (size_t) rs->get2DRasterDataBuffer() % RasterDataAlignment);
+    EXPECT_EQ(3, rs->getCellStride());
+    EXPECT_EQ(1, rs->getLayerStride());
+    // position data is one packed buffer of (row, col) pairs
+    ASSERT_NE(nullptr, rs->getRasterPositionBuffer());
+    EXPECT_EQ(rs->getRasterPositionBuffer(), rs->getRasterPositionDataPointer()[0]);
+    EXPECT_EQ(rs->getRasterPositionBuffer() + 72 * 2, rs->getRasterPositionDataPointer()[72]);
+    EXPECT_EQ(maskrs->getRasterPositionBuffer(), rs->getRasterPositionBuffer());  // borrowed from the mask
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, SpanIndex) {
+    // row-span index of valid cells
+    const clsRasterSpanIndex *spans = rs->getSpanIndex();
+    ASSERT_NE(nullptr, spans);
+    EXPECT_EQ(spans, rs->getSpanIndex());  // built once
+    EXPECT_EQ(maskrs->getSpanIndex(), spans);  // shared with the mask
+    // unsorted positions have no span index, and the failed build is not retried
+    int **unsorted = nullptr;
+    _initialize_2d_buffer(2, 2, unsorted, 0);
+    unsorted[0][0] = 1;  // (1, 0) before (0, 0)
+    clsRasterPositionIndex unsortedindex(2, 2, unsorted);
+    EXPECT_EQ(nullptr, unsortedindex.getSpanIndex());
+    EXPECT_EQ(nullptr, unsortedindex.getSpanIndex());
+    // one position index is shared by the mask and the rasters borrowing its positions
+    ASSERT_NE(nullptr, rs->getPositionIndex());
+    EXPECT_EQ(maskrs->getPositionIndex(), rs->getPositionIndex());
+    EXPECT_EQ(73, rs->getPositionIndex()->getCellNumber());
+    EXPECT_EQ(rs->getRasterPositionDataPointer(), rs->getPositionIndex()->getPositions());
+    EXPECT_EQ(73, spans->getCellNumber());
+    EXPECT_EQ(9, spans->getRows());
+    EXPECT_LT(spans->getSpanNumber(), 73);
+    int spancells = 0;
+    for (int row = 0; row < spans->getRows(); row++) {
+        for (int s = spans->getRowSpanBegin(row); s < spans->getRowSpanEnd(row); s++) {
+            EXPECT_EQ(spancells, spans->getSpanStart(s));
+            spancells += spans->getSpanLength(s);
+        }
+    }
+    EXPECT_EQ(73, spancells);
+    for (int i = 0; i < 73; i++) {
+        int row = rs->getRasterPositionDataPointer()[i][0];
+        int col = rs->getRasterPositionDataPointer()[i][1];
+        EXPECT_EQ(i, spans->find(row, col));
+        EXPECT_EQ(i, rs->getPosition(row, col));
+        int prow = -1;
+        int pcol = -1;
+        EXPECT_TRUE(spans->getCellPosition(i, &prow, &pcol));
+        EXPECT_EQ(row, prow);
+        EXPECT_EQ(col, pcol);
+    }
+    EXPECT_EQ(-1, spans->find(-1, 0));
+    EXPECT_EQ(-1, spans->find(9, 0));
+    for (int row = 0; row < 9; row++) {  // the same as scanning all positions
+        for (int col = 0; col < 10; col++) {
+            int expected = -1;  // NODATA
+            for (int i = 0; i < 73 && expected < 0; i++) {
+                if (rs->getRasterPositionDataPointer()[i][0] == row &&
+                    rs->getRasterPositionDataPointer()[i][1] == col) {
+                    expected = i;
+                }
+            }
+            EXPECT_EQ(expected, rs->getPosition(row, col));
+        }
+    }
+    EXPECT_EQ(-2, rs->getPosition(9, 0));  // out of extent
+    EXPECT_FALSE(spans->getCellPosition(73, nullptr, nullptr));
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, OutputCOG) {
+    string newcorename = "dem_2D-pos_incst-mask-pos-ext";
+    string oldfullname = rs->getFilePath();
+    // output to Cloud-Optimized GeoTIFF, one file per layer
+    string cogfullname = GetPathFromFullName(oldfullname) + "result" + SEP +
+        newcorename + "_" + GetSuffix(oldfullname) + "_cog." + GTiffExtension;
+    EXPECT_TRUE(rs->outputCOGFile(cogfullname, 16));
+    EXPECT_TRUE(FileExists(GetPathFromFullName(oldfullname) + "result" + SEP +
+        newcorename + "_" + GetSuffix(oldfullname) + "_cog_3." + GTiffExtension));
+    GDALDataset *cogds = (GDALDataset *) GDALOpen((GetPathFromFullName(oldfullname) + "result" + SEP +
+        newcorename + "_" + GetSuffix(oldfullname) + "_cog_3." + GTiffExtension).c_str(), GA_ReadOnly);
+    ASSERT_NE(nullptr, cogds);
+    EXPECT_EQ(0, cogds->GetRasterBand(1)->GetOverviewCount());  // fits into one tile
+    GDALClose(cogds);
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, ConcurrentLayerOutput) {
+    string newcorename = "dem_2D-pos_incst-mask-pos-ext";
+    string oldfullname = rs->getFilePath();
+    // write layers concurrently
+    rs->setOutputThreadNumber(2);
+    EXPECT_EQ(2, rs->getOutputThreadNumber());
+    string parfullname = GetPathFromFullName(oldfullname) + "result" + SEP +
+        newcorename + "_par." + GetSuffix(oldfullname);
+    EXPECT_TRUE(rs->outputToFile(parfullname));
+    for (int lyr = 1; lyr <= rs->getLayers(); lyr++) {
+        clsRasterData<float> *lyrrs = clsRasterData<float>::Init(GetPathFromFullName(oldfullname) + "result" +
+            SEP + newcorename + "_par_" + ValueToString(lyr) + "." + GetSuffix(oldfullname));
+        ASSERT_NE(nullptr, lyrrs);
+        EXPECT_FLOAT_EQ(rs->getValue(2, 4, lyr), lyrrs->getValue(2, 4));
+        delete lyrrs;
+    }
+    rs->setOutputThreadNumber(0);
+    EXPECT_EQ(0, rs->getOutputThreadNumber());
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, CopySharesPositionIndex) {
+    long holders = rs->getPositionIndex().use_count();
+    clsRasterData<float, int> *copyrs = new clsRasterData<float, int>(rs);
+    // the position index is shared rather than copied
+    EXPECT_EQ(rs->getPositionIndex(), copyrs->getPositionIndex());
+    EXPECT_EQ(holders + 1, rs->getPositionIndex().use_count());
+    EXPECT_EQ(rs->getRasterPositionDataPointer(), copyrs->getRasterPositionDataPointer());
+    EXPECT_EQ(rs->PositionsAllocated(), copyrs->PositionsAllocated());
+    EXPECT_EQ(rs->getPosition(2, 4), copyrs->getPosition(2, 4));
+    EXPECT_NE(rs->get2DRasterDataBuffer(), copyrs->get2DRasterDataBuffer());
+    EXPECT_EQ(copyrs->get2DRasterDataBuffer() + 3, copyrs->get2DRasterDataPointer()[1]);
+    holders = rs->getPositionIndex().use_count();
+    delete copyrs;
+    EXPECT_EQ(holders - 1, rs->getPositionIndex().use_count());
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, MoveAndSwap) {
+    EXPECT_FLOAT_EQ(8.43900000f, rs->getAverage(3));  // statistics are moved as well
+    clsRasterData<float, int> *copyrs = new clsRasterData<float, int>(rs);
+    clsRasterData<float, int> *movefromrs = new clsRasterData<float, int>(rs);
+    float **movedata = movefromrs->get2DRasterDataPointer();
+    clsRasterData<float, int> movedrs(std::move(*movefromrs));
+    // buffers, position index and statistics are transferred without copying
+    EXPECT_EQ(movedata, movedrs.get2DRasterDataPointer());
+    EXPECT_EQ(rs->getPositionIndex(), movedrs.getPositionIndex());
+    EXPECT_EQ(73, movedrs.getCellNumber());
+    EXPECT_TRUE(movedrs.StatisticsCalculated());
+    EXPECT_FLOAT_EQ(8.43900000f, movedrs.getAverage(3));
+    EXPECT_FLOAT_EQ(rs->getValue(2, 4, 2), movedrs.getValue(2, 4, 2));
+    // the moved-from raster is blank
+    EXPECT_TRUE(movefromrs->Initialized());
+    EXPECT_EQ(-1, movefromrs->getCellNumber());
+    EXPECT_EQ(-9999, movefromrs->getRows());
+    EXPECT_EQ(nullptr, movefromrs->get2DRasterDataPointer());
+    EXPECT_EQ(nullptr, movefromrs->getPositionIndex());
+    EXPECT_FALSE(movefromrs->validate_raster_data());
+    // move assignment
+    *movefromrs = std::move(movedrs);
+    EXPECT_EQ(movedata, movefromrs->get2DRasterDataPointer());
+    EXPECT_EQ(nullptr, movedrs.get2DRasterDataPointer());
+    // swap
+    clsRasterData<float, int> swappedrs;
+    swap(swappedrs, *movefromrs);
+    EXPECT_EQ(movedata, swappedrs.get2DRasterDataPointer());
+    EXPECT_EQ(nullptr, movefromrs->get2DRasterDataPointer());
+    EXPECT_EQ(-1, movefromrs->getCellNumber());
+    delete movefromrs;
+    // rasters stored by value, buffers are kept while the vector grows
+    vector<clsRasterData<float, int> > rasters;
+    rasters.push_back(std::move(swappedrs));
+    rasters.emplace_back(rs);
+    rasters.emplace_back(copyrs);
+    EXPECT_EQ(movedata, rasters[0].get2DRasterDataPointer());
+    EXPECT_FLOAT_EQ(rs->getValue(2, 4, 2), rasters[0].getValue(2, 4, 2));
+    EXPECT_FLOAT_EQ(8.43900000f, rasters[2].getAverage(3));
+    delete copyrs;
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, LayerMajorLayout) {
+    clsRasterData<float, int> *layerrs = new clsRasterData<float, int>(rs);
+    EXPECT_EQ(RL_CellMajor, layerrs->getRasterLayout());
+    EXPECT_EQ(nullptr, layerrs->getLayerDataPointer(1));
+    EXPECT_TRUE(layerrs->transposeLayout(RL_LayerMajor));
+    EXPECT_EQ(RL_LayerMajor, layerrs->getRasterLayout());
+    ASSERT_NE(nullptr, layerrs->getLayerDataPointer(2));
+    EXPECT_EQ(layerrs->get2DRasterDataBuffer() + 73, layerrs->getLayerDataPointer(2));
+    EXPECT_EQ(nullptr, layerrs->getLayerDataPointer(4));
+    for (int i = 0; i < rs->getCellNumber(); i++) {
+        for (int lyr = 1; lyr <= 3; lyr++) {
+            EXPECT_FLOAT_EQ(rs->getValueByIndex(i, lyr), layerrs->getLayerDataPointer(lyr)[i]);
+            EXPECT_FLOAT_EQ(rs->getValueByIndex(i, lyr), layerrs->getValueByIndex(i, lyr));
+        }
+    }
+    EXPECT_FLOAT_EQ(rs->getValue(2, 4, 2), layerrs->getValue(2, 4, 2));
+    ASSERT_GE(layerrs->getPosition(2, 4), 0);
+    EXPECT_EQ(60, layerrs->getValidNumber(2));
+    EXPECT_FLOAT_EQ(8.43900000f, layerrs->getAverage(3));
+    // statistics through the validity bitmask
+    layerrs->buildValidityMask();
+    layerrs->updateStatistics();
+    EXPECT_EQ(60, layerrs->getValidNumber(2));
+    EXPECT_FLOAT_EQ(10.23766667f, layerrs->getAverage(2));
+    EXPECT_FLOAT_EQ(11.52952953f, layerrs->getSTD(2));
+    EXPECT_FLOAT_EQ(8.43900000f, layerrs->getAverage(3));
+    layerrs->setValue(2, 4, 1.f, 2);
+    EXPECT_FLOAT_EQ(1.f, layerrs->getLayerDataPointer(2)[layerrs->getPosition(2, 4)]);
+    // copy keeps the layout
+    clsRasterData<float, int> *layercopyrs = new clsRasterData<float, int>(layerrs);
+    EXPECT_EQ(RL_LayerMajor, layercopyrs->getRasterLayout());
+    EXPECT_FLOAT_EQ(1.f, layercopyrs->getValue(2, 4, 2));
+    // transpose back to cell-major
+    EXPECT_TRUE(layerrs->transposeLayout(RL_CellMajor));
+    EXPECT_EQ(RL_CellMajor, layerrs->getRasterLayout());
+    EXPECT_FLOAT_EQ(1.f, layerrs->get2DRasterDataPointer()[layerrs->getPosition(2, 4)][1]);
+    EXPECT_FLOAT_EQ(rs->getValue(3, 5, 3), layerrs->get2DRasterDataPointer()[layerrs->getPosition(3, 5)][2]);
+    // layer planes padded to the alignment, i.e., 73 floats to 80
+    EXPECT_TRUE(layerrs->transposeLayout(RL_LayerMajor, true));
+    EXPECT_EQ(1, layerrs->getCellStride());
+    EXPECT_EQ(80, layerrs->getLayerStride());
+    EXPECT_EQ(layerrs->get2DRasterDataBuffer() + 80 * 2, layerrs->getLayerDataPointer(3));
+    EXPECT_EQ(0u, (size_t) layerrs->getLayerDataPointer(2) % RasterDataAlignment);
+    EXPECT_FLOAT_EQ(1.f, layerrs->getValue(2, 4, 2));
+    EXPECT_FLOAT_EQ(rs->getValue(3, 5, 3), layerrs->getLayerDataPointer(3)[layerrs->getPosition(3, 5)]);
+    EXPECT_FLOAT_EQ(8.43900000f, layerrs->getAverage(3));
+    clsRasterData<float, int> *paddedcopyrs = new clsRasterData<float, int>(layerrs);
+    EXPECT_EQ(80, paddedcopyrs->getLayerStride());
+    EXPECT_FLOAT_EQ(1.f, paddedcopyrs->getValue(2, 4, 2));
+    delete paddedcopyrs;
+    delete layercopyrs;
+    delete layerrs;
+
+}
+
+#ifdef USE_MONGODB
+/// Write the raster as pixel interleaved, band interleaved (<name>_band), and compact (<name>_compact) GridFS files
+void WriteGridFSLayouts(clsRasterData<float, int> *rs, MongoGridFS *gfs, const string &gfsfilename) {
+    gfs->removeFile(gfsfilename);
+    rs->outputToMongoDB(gfsfilename, gfs);
+    gfs->removeFile(gfsfilename + "_band");
+    rs->setGridFSBandInterleaved(true);
+    rs->outputToMongoDB(gfsfilename + "_band", gfs);
+    rs->setGridFSBandInterleaved(false);
+    gfs->removeFile(gfsfilename + "_compact");
+    rs->outputToMongoDB(gfsfilename + "_compact", gfs, true);
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, MongoDBLayouts) {
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    string gfsfilename = "dem_2D-pos_incst-mask-pos-ext_layouts_" + GetSuffix(rs->getFilePath());
+    WriteGridFSLayouts(rs, gfs, gfsfilename);
+    // data is streamed chunk by chunk and gathered to the valid cells of the mask
+    clsRasterData<float, int> *mongors = clsRasterData<float, int>::Init(gfs, gfsfilename.c_str(), true, maskrs, true);
+    ASSERT_NE(nullptr, mongors);
+    EXPECT_EQ(73, mongors->getCellNumber());
+    EXPECT_EQ(3, mongors->getLayers());
+    EXPECT_EQ(64, mongors->getValidNumber(1));
+    EXPECT_FLOAT_EQ(8.43900000f, mongors->getAverage(3));
+    for (int i = 0; i < mongors->getCellNumber(); i++) {
+        int row = mongors->getRasterPositionDataPointer()[i][0];
+        int col = mongors->getRasterPositionDataPointer()[i][1];
+        for (int lyr = 1; lyr <= 3; lyr++) {
+            EXPECT_FLOAT_EQ(rs->getValue(row, col, lyr), mongors->get2DRasterDataPointer()[i][lyr - 1]);
+        }
+    }
+    // compact layout, i.e., valid cells and run-length positions
+    bson_t *bmeta = gfs->getFileMetadata(gfsfilename + "_compact");
+    EXPECT_EQ("COMPACT", GetStringFromBson(bmeta, HEADER_RS_LAYOUT));
+    bson_destroy(bmeta);
+    clsRasterData<float, int> *compactrs = clsRasterData<float, int>::Init(gfs, (gfsfilename + "_compact").c_str(),
+                                                                           true, maskrs, true);
+    ASSERT_NE(nullptr, compactrs);
+    EXPECT_EQ(73, compactrs->getCellNumber());
+    EXPECT_FALSE(compactrs->PositionsAllocated());  // positions are borrowed from mask directly
+    EXPECT_EQ(maskrs->getRasterPositionDataPointer(), compactrs->getRasterPositionDataPointer());
+    EXPECT_EQ(3, compactrs->getLayers());
+    EXPECT_EQ(64, compactrs->getValidNumber(1));
+    EXPECT_FLOAT_EQ(8.43900000f, compactrs->getAverage(3));
+    delete compactrs;
+    // band interleaved layout, i.e., layer-major
+    bmeta = gfs->getFileMetadata(gfsfilename + "_band");
+    EXPECT_EQ("BAND", GetStringFromBson(bmeta, HEADER_RS_LAYOUT));
+    bson_destroy(bmeta);
+    clsRasterData<float, int> *bandrs = clsRasterData<float, int>::Init(gfs, (gfsfilename + "_band").c_str(),
+                                                                        true, maskrs, true);
+    ASSERT_NE(nullptr, bandrs);
+    EXPECT_EQ(73, bandrs->getCellNumber());
+    EXPECT_FLOAT_EQ(8.43900000f, bandrs->getAverage(3));
+    for (int i = 0; i < bandrs->getCellNumber(); i++) {
+        for (int lyr = 0; lyr < 3; lyr++) {
+            EXPECT_FLOAT_EQ(mongors->get2DRasterDataPointer()[i][lyr], bandrs->get2DRasterDataPointer()[i][lyr]);
+        }
+    }
+    delete bandrs;
+    delete mongors;
+    delete gfs;
+    delete conn;
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, MongoDBWindow) {
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    string gfsfilename = "dem_2D-pos_incst-mask-pos-ext_window_" + GetSuffix(rs->getFilePath());
+    WriteGridFSLayouts(rs, gfs, gfsfilename);
+    // windowed reads of rows and layers, from pixel and band interleaved layouts,
+    // and only the covered blocks are decoded if compressed
+    vector<string> winnames;
+    winnames.emplace_back(gfsfilename);
+    winnames.emplace_back(gfsfilename + "_band");
+    if (rs->setGridFSCompression(RCP_LZ4, 64)) {
+        winnames.emplace_back(gfsfilename + "_band_lz4");
+        gfs->removeFile(winnames.back());
+        rs->setGridFSBandInterleaved(true);
+        rs->outputToMongoDB(winnames.back(), gfs);
+        rs->setGridFSBandInterleaved(false);
+        rs->setGridFSCompression(RCP_None);
+    }
+    for (int f = 0; f < (int) winnames.size(); f++) {
+        clsRasterData<float, int> *winrs = new clsRasterData<float, int>();
+        ASSERT_TRUE(winrs->ReadWindowFromMongoDB(gfs, winnames[f], 2, 3, vector<int>(1, 3)));
+        EXPECT_EQ(3, winrs->getRows());
+        EXPECT_EQ(rs->getCols(), winrs->getCols());
+        EXPECT_EQ(1, winrs->getLayers());
+        EXPECT_NEAR(rs->getYllCenter() + (rs->getRows() - 5) * rs->getCellWidth(),
+                    winrs->getYllCenter(), 1.e-6);
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < winrs->getCols(); col++) {
+                EXPECT_FLOAT_EQ(rs->getValue(row + 2, col, 3), winrs->getValue(row, col));
+            }
+        }
+        delete winrs;
+    }
+    clsRasterData<float, int> *winrs = new clsRasterData<float, int>();
+    EXPECT_FALSE(winrs->ReadWindowFromMongoDB(gfs, gfsfilename, 8, 3));  // out of extent
+    EXPECT_FALSE(winrs->ReadWindowFromMongoDB(gfs, gfsfilename + "_compact", 0, 1));  // COMPACT is not supported
+    ASSERT_TRUE(winrs->ReadWindowFromMongoDB(gfs, gfsfilename + "_band", 0, rs->getRows()));
+    EXPECT_EQ(3, winrs->getLayers());
+    EXPECT_FLOAT_EQ(8.43900000f, winrs->getAverage(3));
+    delete winrs;
+    delete gfs;
+    delete conn;
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, MongoDBHeaders) {
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    string gfsfilename = "dem_2D-pos_incst-mask-pos-ext_headers_" + GetSuffix(rs->getFilePath());
+    WriteGridFSLayouts(rs, gfs, gfsfilename);
+    // header-only queries
+    map<string, double> gfsheader;
+    string gfssrs;
+    EXPECT_FALSE(ReadRasterHeaderFromMongoDB(gfs, "noExistRaster", gfsheader));
+    // metadata without NROWS is not a raster
+    bson_t nonraster = BSON_INITIALIZER;
+    BSON_APPEND_DOUBLE(&nonraster, HEADER_RS_NCOLS, 5.);
+    char *nonrasterdata = new char[8]();
+    gfs->writeStreamData("nonRaster", nonrasterdata, 8, &nonraster);
+    delete[] nonrasterdata;
+    bson_destroy(&nonraster);
+    gfsheader[HEADER_RS_NROWS] = 1.;
+    EXPECT_FALSE(ReadRasterHeaderFromMongoDB(gfs, "nonRaster", gfsheader));
+    EXPECT_TRUE(gfsheader.empty());
+    ASSERT_TRUE(ReadRasterHeaderFromMongoDB(gfs, gfsfilename + "_band", gfsheader, &gfssrs));
+    EXPECT_EQ(rs->getRows(), (int) gfsheader.at(HEADER_RS_NROWS));
+    EXPECT_EQ(rs->getCols(), (int) gfsheader.at(HEADER_RS_NCOLS));
+    EXPECT_EQ(3, (int) gfsheader.at(HEADER_RS_LAYERS));
+    EXPECT_FLOAT_EQ(rs->getCellWidth(), (float) gfsheader.at(HEADER_RS_CELLSIZE));
+    EXPECT_EQ(rs->getSRSString(), gfssrs);
+    vector<string> bulknames;
+    bulknames.emplace_back(gfsfilename);
+    bulknames.emplace_back(gfsfilename + "_band");
+    bulknames.emplace_back("noExistRaster");
+    bulknames.emplace_back(gfsfilename + "_compact");
+    bulknames.emplace_back("nonRaster");
+    map<string, map<string, double> > gfsheaders;
+    map<string, string> gfssrss;
+    EXPECT_EQ(3, ReadRasterHeadersFromMongoDB(gfs, bulknames, gfsheaders, &gfssrss));
+    gfs->removeFile("nonRaster");
+    EXPECT_EQ(3, (int) gfsheaders.size());
+    EXPECT_TRUE(gfsheaders.find("noExistRaster") == gfsheaders.end());
+    for (auto it = gfsheaders.begin(); it != gfsheaders.end(); it++) {
+        EXPECT_EQ(rs->getRows(), (int) it->second.at(HEADER_RS_NROWS));
+        EXPECT_EQ(3, (int) it->second.at(HEADER_RS_LAYERS));
+        EXPECT_EQ(rs->getSRSString(), gfssrss[it->first]);
+    }
+    EXPECT_EQ(73, (int) gfsheaders[gfsfilename + "_compact"].at(HEADER_RS_CELLSNUM));
+    delete gfs;
+    delete conn;
+}
+
+TEST_P(clsRasterDataTestMultiPosIncstMaskPosExt, MongoDBBatch) {
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    string gfsfilename = "dem_2D-pos_incst-mask-pos-ext_batch_" + GetSuffix(rs->getFilePath());
+    WriteGridFSLayouts(rs, gfs, gfsfilename);
+    vector<string> bulknames;
+    bulknames.emplace_back(gfsfilename);
+    bulknames.emplace_back(gfsfilename + "_band");
+    bulknames.emplace_back("noExistRaster");
+    bulknames.emplace_back(gfsfilename + "_compact");
+    // bulk loading in parallel through a client pool
+    mongoc_uri_t *uri = mongoc_uri_new("mongodb://127.0.0.1:27017");
+    mongoc_client_pool_t *pool = mongoc_client_pool_new(uri);
+    vector<clsRasterData<float, int> *> bulkrs = clsRasterData<float, int>::BatchInit(pool, "test", "spatial",
+                                                                                     bulknames, true, maskrs,
+                                                                                     true, 2);
+    ASSERT_EQ(4, (int) bulkrs.size());
+    EXPECT_EQ(nullptr, bulkrs[2]);
+    for (int f = 0; f < 4; f++) {
+        if (f == 2) continue;
+        ASSERT_NE(nullptr, bulkrs[f]);
+        EXPECT_EQ(73, bulkrs[f]->getCellNumber());
+        EXPECT_EQ(3, bulkrs[f]->getLayers());
+        EXPECT_FLOAT_EQ(8.43900000f, bulkrs[f]->getAverage(3));
+        EXPECT_FLOAT_EQ(rs->get2DRasterDataPointer()[10][1], bulkrs[f]->get2DRasterDataPointer()[10][1]);
+    }
+    // batched output in parallel through a client pool
+    vector<string> outnames;
+    for (int f = 0; f < 4; f++) {
+        outnames.emplace_back("batch_" + ValueToString(f) + "_" + gfsfilename);
+    }
+    vector<int> completed(4, -1);
+    vector<int> ompthreads(4, 1);
+    vector<bool> written = clsRasterData<float, int>::BatchOutputToMongoDB(
+        pool, "test", "spatial", bulkrs, outnames, false, 3,
+        [&completed, &ompthreads](int idx, bool flag) {
+            completed[idx] = flag ? 1 : 0;
+#ifdef SUPPORT_OMP
+            ompthreads[idx] = omp_get_max_threads();
+#endif
+        });
+    ASSERT_EQ(4, (int) written.size());
+#ifdef SUPPORT_OMP
+    // the OpenMP threads of each worker are limited to its share
+    for (int f = 0; f < 4; f++) {
+        EXPECT_EQ(max(1, omp_get_max_threads() / 3), ompthreads[f]);
+    }
+#endif
+    for (int f = 0; f < 4; f++) {
+        EXPECT_EQ(f != 2, written[f]);
+        EXPECT_EQ(f != 2 ? 1 : 0, completed[f]);
+        if (f == 2) continue;
+        clsRasterData<float, int> *batchrs = clsRasterData<float, int>::Init(gfs, outnames[f].c_str(),
+                                                                             true, maskrs, true);
+        ASSERT_NE(nullptr, batchrs);
+        EXPECT_EQ(73, batchrs->getCellNumber());
+        EXPECT_FLOAT_EQ(8.43900000f, batchrs->getAverage(3));
+        EXPECT_FLOAT_EQ(rs->get2DRasterDataPointer()[10][1], batchrs->get2DRasterDataPointer()[10][1]);
+        delete batchrs;
+        gfs->removeFile(outnames[f]);
+        delete bulkrs[f];
+    }
+    mongoc_client_pool_destroy(pool);
+    mongoc_uri_destroy(uri);
+    delete gfs;
+    delete conn;
+}
+#endif /* USE_MONGODB */
+
 INSTANTIATE_TEST_CASE_P(MultipleLayers, clsRasterDataTestMultiPosIncstMaskPosExt,
                         Values(new inputRasterFiles(rs1_asc, rs2_asc, rs3_asc, mask_asc_file),
                                new inputRasterFiles(rs1_tif, rs2_tif, rs3_tif, mask_tif_file)));
@@ -0,0 +1,97 @@
+/*!
+ * @brief Test the asynchronous output of clsRasterData by clsRasterOutputQueue.
+ *        The raster is modified right after each submission, and the written
+ *        files must keep the values at the time of submission.
+ *
+ * @version 1.0
+ * @revised 10/18/2026 Initial version.
+ *
+ */
+#include "gtest/gtest.h"
+#include "utilities.h"
+#include "clsRasterData.h"
+
+namespace {
+TEST(clsRasterDataTestAsyncOutput, SnapshotAndFlush) {
+    string apppath = GetAppPath();
+    string resultpath = apppath + "../data/result" + SEP;
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    EXPECT_FLOAT_EQ(8.06f, rs->getValue(2, 4));
+
+    /// Invalid queue leads to a finished and failed handle
+    EXPECT_FALSE(rs->outputToFileAsync(nullptr, resultpath + "async_none.asc").get());
+
+    clsRasterOutputQueue *queue = new clsRasterOutputQueue(2, 2);
+    EXPECT_EQ(2, queue->getWriterNumber());
+    vector<shared_future<bool> > handles;
+    for (int t = 0; t < 6; t++) {
+        rs->setValue(2, 4, (float) t);
+        handles.push_back(rs->outputToFileAsync(queue, resultpath + "async_t" + ValueToString(t) + ".asc"));
+    }
+    rs->setValue(2, 4, 100.f);  // modification after submission never affects the outputs
+    queue->flush();
+    for (int t = 0; t < 6; t++) {
+        EXPECT_TRUE(handles[t].get());
+        string outfile = resultpath + "async_t" + ValueToString(t) + ".asc";
+        EXPECT_TRUE(FileExists(outfile));
+        clsRasterData<float> *outrs = clsRasterData<float>::Init(outfile);
+        ASSERT_NE(nullptr, outrs);
+        EXPECT_EQ(rs->getCellNumber(), outrs->getCellNumber());
+        EXPECT_FLOAT_EQ((float) t, outrs->getValue(2, 4));
+        EXPECT_FLOAT_EQ(rs->getValue(2, 5), outrs->getValue(2, 5));
+        delete outrs;
+    }
+    delete queue;  // flush is also invoked implicitly by destructor
+    delete rs;
+}
+
+TEST(clsRasterDataTestAsyncOutput, ThreadBudget) {
+    clsRasterOutputQueue *queue = new clsRasterOutputQueue(2, 2, 3);
+    EXPECT_EQ(3, queue->getThreadNumber());
+#ifdef SUPPORT_OMP
+    int nthreads = 0;
+    EXPECT_TRUE(queue->submit([&nthreads]() {
+        nthreads = omp_get_max_threads();  /// parallel regions of the tasks use the budget
+        return true;
+    }).get());
+    EXPECT_EQ(3, nthreads);
+#endif /* SUPPORT_OMP */
+    delete queue;
+    /// by default, the writers share the threads of the caller
+    queue = new clsRasterOutputQueue(2);
+#ifdef SUPPORT_OMP
+    EXPECT_EQ(max(1, omp_get_max_threads() / 2), queue->getThreadNumber());
+#else
+    EXPECT_EQ(1, queue->getThreadNumber());
+#endif /* SUPPORT_OMP */
+    delete queue;
+}
+
+#ifdef USE_MONGODB
+TEST(clsRasterDataTestAsyncOutput, MongoDB) {
+    string apppath = GetAppPath();
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    clsRasterOutputQueue *queue = new clsRasterOutputQueue(1, 2);
+    EXPECT_FALSE(rs->outputToMongoDBAsync(queue, "async_dem_2", nullptr).get());
+    /// get() reports whether the file exists after writing
+    shared_future<bool> handle = rs->outputToMongoDBAsync(queue, "async_dem_2", gfs);
+    rs->setValue(2, 4, 100.f);
+    EXPECT_TRUE(handle.get());
+    clsRasterData<float> *outrs = clsRasterData<float>::Init(gfs, "async_dem_2");
+    ASSERT_NE(nullptr, outrs);
+    EXPECT_EQ(rs->getCellNumber(), outrs->getCellNumber());
+    EXPECT_FLOAT_EQ(8.06f, outrs->getValue(2, 4));
+    gfs->removeFile("async_dem_2");
+    delete outrs;
+    delete queue;
+    delete gfs;
+    delete conn;
+    delete rs;
+}
+#endif /* USE_MONGODB */
+} /* namespace */
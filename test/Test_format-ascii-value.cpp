@@ -0,0 +1,101 @@
+/*!
+ * @brief Test the fast formatting of ASC values, i.e., _format_float_g6, which must be
+ *        byte-identical to snprintf("%.6g") and `ostream << setprecision(6)`.
+ *
+ * @version 1.0
+ * @revised 10/18/2026 Initial version.
+ *
+ */
+#include "gtest/gtest.h"
+#include "utilities.h"
+#include "clsRasterData.h"
+
+#include <limits>
+
+namespace {
+/// Check the formatted text of \a value with snprintf and ostream
+void ExpectSameAsPrintf(double value) {
+    char buf[32];
+    int len = _format_float_g6(value, buf);
+    string fast(buf, len);
+    char expected[32];
+    snprintf(expected, sizeof(expected), "%.6g", value);
+    EXPECT_EQ(string(expected), fast) << "value: " << setprecision(17) << value;
+    ostringstream oss;
+    oss << setprecision(6) << value;
+    EXPECT_EQ(oss.str(), fast) << "value: " << setprecision(17) << value;
+}
+
+TEST(clsRasterDataTestFormat, PowersOfTen) {
+    for (int e = -30; e <= 30; e++) {
+        double p = pow(10., e);
+        ExpectSameAsPrintf(p);
+        ExpectSameAsPrintf(-p);
+        ExpectSameAsPrintf(9.999995 * p);  /// rounds up to the next power of ten
+        ExpectSameAsPrintf(9.999994 * p);
+        ExpectSameAsPrintf(1.000005 * p);
+        ExpectSameAsPrintf(nextafter(p, 0.));
+        ExpectSameAsPrintf(nextafter(p, 1e300));
+        ExpectSameAsPrintf((double) (float) p);
+    }
+}
+
+TEST(clsRasterDataTestFormat, NotationBoundaries) {
+    /// fixed notation for 1e-5 < |x| < 1e6 after rounding to 6 significant digits
+    const double values[] = {1e-5, 1e-4, 9.99999e-5, 9.999995e-5, 9.999994e-5, 0.000123456, 0.0001234565,
+                             1e5, 1e6, 999999., 999999.4, 999999.5, 999999.6, 99999.95, 123456.5, 123457.5,
+                             0.5, 1.5, 2.5, 0.15, 0.25, 1.0000005, 8.06, -9999., 1234.5678, 3.14159265358979};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        ExpectSameAsPrintf(values[i]);
+        ExpectSameAsPrintf(-values[i]);
+        ExpectSameAsPrintf((double) (float) values[i]);
+    }
+}
+
+TEST(clsRasterDataTestFormat, NearTies) {
+    /// the 7th significant digit is (about) 5, i.e., ties of rounding in decimal
+    const double ties[] = {123456.5, 100000.5, 999999.5, 555555.5, 123456.49999, 123456.50001};
+    for (int e = -12; e <= 12; e++) {
+        for (size_t i = 0; i < sizeof(ties) / sizeof(ties[0]); i++) {
+            double v = ties[i] * pow(10., e - 5);
+            ExpectSameAsPrintf(v);
+            ExpectSameAsPrintf(-v);
+            ExpectSameAsPrintf(nextafter(v, 0.));
+            ExpectSameAsPrintf(nextafter(v, 1e300));
+            ExpectSameAsPrintf((double) (float) v);
+        }
+    }
+}
+
+TEST(clsRasterDataTestFormat, SpecialValues) {
+    ExpectSameAsPrintf(0.);
+    ExpectSameAsPrintf(-0.);
+    ExpectSameAsPrintf(numeric_limits<double>::denorm_min());
+    ExpectSameAsPrintf(-numeric_limits<double>::denorm_min());
+    ExpectSameAsPrintf((double) numeric_limits<float>::denorm_min());
+    ExpectSameAsPrintf((double) numeric_limits<float>::min());
+    ExpectSameAsPrintf((double) numeric_limits<float>::max());
+    ExpectSameAsPrintf(numeric_limits<double>::min());
+    ExpectSameAsPrintf(numeric_limits<double>::max());
+    ExpectSameAsPrintf(numeric_limits<double>::infinity());
+    ExpectSameAsPrintf(-numeric_limits<double>::infinity());
+    ExpectSameAsPrintf(numeric_limits<double>::quiet_NaN());
+}
+
+TEST(clsRasterDataTestFormat, RandomFloats) {
+    mt19937 gen(20261018);
+    uniform_int_distribution<uint32_t> bits;
+    uniform_real_distribution<double> mantissa(-10., 10.);
+    uniform_int_distribution<int> exponent(-20, 20);
+    for (int i = 0; i < 200000; i++) {
+        /// random bit patterns of float, which is the common data type of rasters
+        uint32_t b = bits(gen);
+        float f;
+        memcpy(&f, &b, sizeof(float));
+        ExpectSameAsPrintf((double) f);
+        /// random doubles around typical magnitudes
+        ExpectSameAsPrintf(mantissa(gen) * pow(10., exponent(gen)));
+        if (HasFailure()) break;
+    }
+}
+} /* namespace */
@@ -0,0 +1,287 @@
+/*!
+ * @brief Test the pluggable storage backends of clsRasterData, i.e., clsRasterStorage.
+ *        Rasters written by outputToStorage and read by ReadFromStorage must be the same
+ *        as the original ones, and windows of rows are read and written independently.
+ *
+ * @version 1.0
+ * @revised 10/18/2026 Initial version.
+ *
+ */
+#include "gtest/gtest.h"
+#include "utilities.h"
+#include "clsRasterData.h"
+
+namespace {
+string apppath = GetAppPath();
+string resultpath = apppath + "../data/result" + SEP;
+
+/// Check all cells of the given layer are the same
+template<typename T1, typename M1, typename T2, typename M2>
+void ExpectSameLayer(clsRasterData<T1, M1> *expected, clsRasterData<T2, M2> *actual, int lyr = 1) {
+    ASSERT_EQ(expected->getRows(), actual->getRows());
+    ASSERT_EQ(expected->getCols(), actual->getCols());
+    for (int row = 0; row < expected->getRows(); row++) {
+        for (int col = 0; col < expected->getCols(); col++) {
+            EXPECT_FLOAT_EQ(expected->getValue(row, col, lyr), actual->getValue(row, col, lyr));
+        }
+    }
+}
+
+TEST(clsRasterDataTestStorage, MemorySingleLayer) {
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    clsRasterStorageMemory storage;
+    ASSERT_TRUE(rs->outputToStorage(&storage, "dem_2"));
+
+    map<string, double> header;
+    string srs;
+    EXPECT_FALSE(storage.open("not_existed", header, srs));
+    ASSERT_TRUE(storage.open("dem_2", header, srs));
+    EXPECT_EQ(30, (int) header.at(HEADER_RS_NCOLS));
+    EXPECT_EQ(20, (int) header.at(HEADER_RS_NROWS));
+    EXPECT_EQ(1, (int) header.at(HEADER_RS_LAYERS));
+    EXPECT_DOUBLE_EQ(rs->getXllCenter(), header.at(HEADER_RS_XLL));
+    EXPECT_DOUBLE_EQ(rs->getYllCenter(), header.at(HEADER_RS_YLL));
+    EXPECT_DOUBLE_EQ(-9999., header.at(HEADER_RS_NODATA));
+    /// kept as a typed snapshot and converted by windows
+    EXPECT_NE(nullptr, storage.getHandle("dem_2"));
+    vector<double> rows(2 * 30);
+    ASSERT_TRUE(storage.readWindow("dem_2", 1, 3, 2, &rows[0]));
+    for (int j = 0; j < 30; j++) {
+        EXPECT_FLOAT_EQ(rs->getValue(3, j), (float) rows[j]);
+        EXPECT_FLOAT_EQ(rs->getValue(4, j), (float) rows[30 + j]);
+    }
+
+    clsRasterData<float> *storagers = new clsRasterData<float>();
+    EXPECT_FALSE(storagers->ReadFromStorage(&storage, "not_existed"));
+    ASSERT_TRUE(storagers->ReadFromStorage(&storage, "dem_2"));
+    EXPECT_EQ(rs->getCellNumber(), storagers->getCellNumber());
+    EXPECT_EQ(rs->getValidNumber(), storagers->getValidNumber());
+    EXPECT_FALSE(storagers->is2DRaster());
+    EXPECT_FLOAT_EQ(rs->getAverage(), storagers->getAverage());
+    ExpectSameLayer(rs, storagers);
+    /// the same data type, copied without conversion and the positions are shared
+    EXPECT_EQ(rs->getPositionIndex(), storagers->getPositionIndex());
+
+    /// integer raster from the same storage
+    clsRasterData<int> *intrs = new clsRasterData<int>();
+    ASSERT_TRUE(intrs->ReadFromStorage(&storage, "dem_2", false));
+    EXPECT_EQ(600, intrs->getCellNumber());
+    EXPECT_EQ((int) rs->getValue(0, 1), intrs->getValue(0, 1));
+    /// the first write converts the snapshot to double values
+    ASSERT_TRUE(storage.writeWindow("dem_2", 1, 0, 2, &rows[0]));
+    EXPECT_EQ(nullptr, storage.getHandle("dem_2"));
+    ASSERT_TRUE(storage.readWindow("dem_2", 1, 2, 1, &rows[0]));
+    for (int j = 0; j < 30; j++) {
+        EXPECT_FLOAT_EQ(rs->getValue(2, j), (float) rows[j]);
+    }
+    EXPECT_TRUE(storage.remove("dem_2"));
+    EXPECT_FALSE(storage.open("dem_2", header, srs));
+    delete intrs;
+    delete storagers;
+    delete rs;
+}
+
+TEST(clsRasterDataTestStorage, MemoryMultiLayersWithMask) {
+    clsRasterData<int> *maskrs = clsRasterData<int>::Init(apppath + "../data/mask1.asc", true);
+    ASSERT_NE(nullptr, maskrs);
+    vector<string> filenames;
+    filenames.emplace_back(apppath + "../data/dem_1.asc");
+    filenames.emplace_back(apppath + "../data/dem_2.asc");
+    filenames.emplace_back(apppath + "../data/dem_3.asc");
+    clsRasterData<float, int> *rs = clsRasterData<float, int>::Init(filenames, true, maskrs, true);
+    ASSERT_NE(nullptr, rs);
+    clsRasterStorageMemory storage;
+    ASSERT_TRUE(rs->outputToStorage(&storage, "dem_multi"));
+
+    clsRasterData<float, int> *storagers = new clsRasterData<float, int>();
+    ASSERT_TRUE(storagers->ReadFromStorage(&storage, "dem_multi", true, maskrs, true));
+    EXPECT_TRUE(storagers->is2DRaster());
+    EXPECT_EQ(3, storagers->getLayers());
+    EXPECT_EQ(rs->getCellNumber(), storagers->getCellNumber());
+    for (int lyr = 1; lyr <= 3; lyr++) {
+        EXPECT_EQ(rs->getValidNumber(lyr), storagers->getValidNumber(lyr));
+        EXPECT_FLOAT_EQ(rs->getAverage(lyr), storagers->getAverage(lyr));
+        ExpectSameLayer(rs, storagers, lyr);
+    }
+    /// the mask of snapshot is never restored, since the storage does not keep it alive
+    clsRasterData<float, int> *nomaskrs = new clsRasterData<float, int>();
+    ASSERT_TRUE(nomaskrs->ReadFromStorage(&storage, "dem_multi"));
+    EXPECT_EQ(nullptr, nomaskrs->getMask());
+    for (int lyr = 1; lyr <= 3; lyr++) {
+        ExpectSameLayer(rs, nomaskrs, lyr);
+    }
+    delete storagers;
+    delete rs;
+    delete maskrs;
+    EXPECT_TRUE(nomaskrs->outputToStorage(&storage, "dem_multi_nomask"));
+    delete nomaskrs;
+}
+
+TEST(clsRasterDataTestStorage, MemoryWindow) {
+    map<string, double> header;
+    header[HEADER_RS_NCOLS] = 4;
+    header[HEADER_RS_NROWS] = 5;
+    header[HEADER_RS_XLL] = 1.;
+    header[HEADER_RS_YLL] = 1.;
+    header[HEADER_RS_CELLSIZE] = 2.;
+    header[HEADER_RS_NODATA] = -9999.;
+    header[HEADER_RS_LAYERS] = 2;
+    clsRasterStorageMemory storage;
+    ASSERT_TRUE(storage.create("window", header, ""));
+    double values[20];
+    for (int i = 0; i < 8; i++) values[i] = i + 1.;
+    EXPECT_FALSE(storage.writeWindow("window", 3, 0, 1, values));  // layer out of extent
+    EXPECT_FALSE(storage.writeWindow("window", 1, 4, 2, values));  // rows out of extent
+    ASSERT_TRUE(storage.writeWindow("window", 2, 1, 2, values));
+
+    ASSERT_TRUE(storage.readWindow("window", 2, 0, 5, values));
+    for (int i = 0; i < 20; i++) {
+        EXPECT_DOUBLE_EQ(i >= 4 && i < 12 ? i - 3. : -9999., values[i]);
+    }
+    ASSERT_TRUE(storage.readWindow("window", 1, 2, 1, values));
+    EXPECT_DOUBLE_EQ(-9999., values[0]);
+
+    clsRasterData<float> *rs = new clsRasterData<float>();
+    ASSERT_TRUE(rs->ReadFromStorage(&storage, "window", false));
+    EXPECT_EQ(2, rs->getLayers());
+    EXPECT_EQ(20, rs->getCellNumber());
+    EXPECT_EQ(8, rs->getValidNumber(2));
+    EXPECT_FLOAT_EQ(5.f, rs->getValue(2, 0, 2));
+    delete rs;
+}
+
+TEST(clsRasterDataTestStorage, ASCFile) {
+    clsRasterStorageASC storage;
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    clsRasterData<float> *storagers = new clsRasterData<float>();
+    ASSERT_TRUE(storagers->ReadFromStorage(&storage, apppath + "../data/dem_2.asc"));
+    EXPECT_EQ(rs->getCellNumber(), storagers->getCellNumber());
+    EXPECT_DOUBLE_EQ(rs->getXllCenter(), storagers->getXllCenter());
+    EXPECT_DOUBLE_EQ(rs->getYllCenter(), storagers->getYllCenter());
+    ExpectSameLayer(rs, storagers);
+    delete storagers;
+
+    /// multi-layers are written into independent files
+    clsRasterData<int> *maskrs = clsRasterData<int>::Init(apppath + "../data/mask1.asc", true);
+    ASSERT_NE(nullptr, maskrs);
+    vector<string> filenames;
+    filenames.emplace_back(apppath + "../data/dem_1.asc");
+    filenames.emplace_back(apppath + "../data/dem_2.asc");
+    filenames.emplace_back(apppath + "../data/dem_3.asc");
+    clsRasterData<float, int> *multirs = clsRasterData<float, int>::Init(filenames, true, maskrs, true);
+    ASSERT_NE(nullptr, multirs);
+    string ascfile = resultpath + "storage_multi.asc";
+    ASSERT_TRUE(multirs->outputToStorage(&storage, ascfile));
+    EXPECT_TRUE(FileExists(resultpath + "storage_multi_1.asc"));
+    EXPECT_TRUE(FileExists(resultpath + "storage_multi_3.asc"));
+    map<string, double> header;
+    string srs;
+    ASSERT_TRUE(storage.open(ascfile, header, srs));
+    EXPECT_EQ(3, (int) header.at(HEADER_RS_LAYERS));
+    clsRasterData<float, int> *multistoragers = new clsRasterData<float, int>();
+    ASSERT_TRUE(multistoragers->ReadFromStorage(&storage, ascfile, true, maskrs, true));
+    for (int lyr = 1; lyr <= 3; lyr++) {
+        ExpectSameLayer(multirs, multistoragers, lyr);
+    }
+    /// rewrite one row of the second layer
+    int nCols = multirs->getCols();
+    vector<double> row(nCols, 1.5);
+    ASSERT_TRUE(storage.writeWindow(ascfile, 2, 3, 1, &row[0]));
+    vector<double> rows(2 * nCols);
+    ASSERT_TRUE(storage.readWindow(ascfile, 2, 3, 2, &rows[0]));
+    for (int col = 0; col < nCols; col++) {
+        EXPECT_DOUBLE_EQ(1.5, rows[col]);
+        EXPECT_FLOAT_EQ(multirs->getValue(4, col, 2), (float) rows[nCols + col]);
+    }
+    ASSERT_TRUE(storage.readWindow(ascfile, 1, 3, 1, &row[0]));
+    EXPECT_FLOAT_EQ(multirs->getValue(3, 0, 1), (float) row[0]);
+    /// layers are cached once parsed, and the files are rewritten as well
+    EXPECT_TRUE(storage.release(ascfile));
+    EXPECT_FALSE(storage.release(ascfile));
+    clsRasterStorageASC newstorage;
+    ASSERT_TRUE(newstorage.readWindow(ascfile, 2, 3, 1, &row[0]));
+    EXPECT_DOUBLE_EQ(1.5, row[0]);
+
+    /// a lone <core name>_1.asc is a raster of one layer
+    string lonefile = resultpath + "storage_lone.asc";
+    DeleteExistedFile(lonefile);
+    DeleteExistedFile(resultpath + "storage_lone_2.asc");
+    ASSERT_TRUE(rs->outputASCFile(resultpath + "storage_lone_1.asc"));
+    ASSERT_TRUE(storage.open(lonefile, header, srs));
+    EXPECT_EQ(1, (int) header.at(HEADER_RS_LAYERS));
+    clsRasterData<float> *lonestoragers = new clsRasterData<float>();
+    ASSERT_TRUE(lonestoragers->ReadFromStorage(&storage, lonefile));
+    ExpectSameLayer(rs, lonestoragers);
+    vector<double> lonerow(rs->getCols(), 1.5);
+    ASSERT_TRUE(storage.writeWindow(lonefile, 1, 0, 1, &lonerow[0]));
+    EXPECT_FALSE(FileExists(lonefile));  // written to <core name>_1.asc
+    delete lonestoragers;
+    delete multistoragers;
+    delete multirs;
+    delete maskrs;
+    delete rs;
+}
+
+TEST(clsRasterDataTestStorage, GDALFile) {
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    clsRasterStorageGDAL storage;
+    string tiffile = resultpath + "storage_dem_2.tif";
+    ASSERT_TRUE(rs->outputToStorage(&storage, tiffile));
+    map<string, double> header;
+    string srs;
+    ASSERT_TRUE(storage.open(tiffile, header, srs));
+    EXPECT_EQ(1, (int) header.at(HEADER_RS_LAYERS));
+    EXPECT_DOUBLE_EQ(rs->getXllCenter(), header.at(HEADER_RS_XLL));
+    EXPECT_DOUBLE_EQ(rs->getYllCenter(), header.at(HEADER_RS_YLL));
+    clsRasterData<float> *storagers = new clsRasterData<float>();
+    ASSERT_TRUE(storagers->ReadFromStorage(&storage, tiffile));
+    EXPECT_EQ(rs->getValidNumber(), storagers->getValidNumber());
+    ExpectSameLayer(rs, storagers);
+    delete storagers;
+    delete rs;
+}
+
+#ifdef USE_MONGODB
+TEST(clsRasterDataTestStorage, GridFS) {
+    MongoClient *conn = MongoClient::Init("127.0.0.1", 27017);
+    ASSERT_NE(nullptr, conn);
+    MongoGridFS *gfs = new MongoGridFS(conn->getGridFS("test", "spatial"));
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    clsRasterStorageGridFS storage(gfs, RDT_Int16);
+    string gfsfilename = "storage_dem_2";
+    gfs->removeFile(gfsfilename);
+    ASSERT_TRUE(rs->outputToStorage(&storage, gfsfilename));
+    clsRasterData<float> *storagers = new clsRasterData<float>();
+    ASSERT_TRUE(storagers->ReadFromStorage(&storage, gfsfilename));
+    EXPECT_EQ(rs->getValidNumber(), storagers->getValidNumber());
+    EXPECT_FLOAT_EQ((float) (short) rs->getValue(0, 1), storagers->getValue(0, 1));
+    /// also readable by ReadFromMongoDB
+    clsRasterData<float> *mongors = clsRasterData<float>::Init(gfs, gfsfilename.c_str());
+    ASSERT_NE(nullptr, mongors);
+    ExpectSameLayer(storagers, mongors);
+    delete mongors;
+
+    /// windows of the raster compressed by outputToMongoDB
+    rs->setGridFSCompression(RCP_LZ4, 64);
+    rs->outputToMongoDB(gfsfilename, gfs);
+    clsRasterStorageGridFS floatstorage(gfs);
+    vector<double> row(rs->getCols(), 1.5);
+    ASSERT_TRUE(floatstorage.writeWindow(gfsfilename, 1, 3, 1, &row[0]));
+    vector<double> rows(2 * rs->getCols());
+    ASSERT_TRUE(floatstorage.readWindow(gfsfilename, 1, 2, 2, &rows[0]));
+    for (int col = 0; col < rs->getCols(); col++) {
+        EXPECT_FLOAT_EQ(rs->getValue(2, col), (float) rows[col]);
+        EXPECT_DOUBLE_EQ(1.5, rows[rs->getCols() + col]);
+    }
+    EXPECT_FALSE(floatstorage.readWindow(gfsfilename, 2, 0, 1, &row[0]));
+    gfs->removeFile(gfsfilename);
+    delete storagers;
+    delete rs;
+    delete gfs;
+}
+#endif /* USE_MONGODB */
+} /* namespace */
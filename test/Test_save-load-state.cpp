@@ -0,0 +1,118 @@
+/*!
+ * @brief Test the binary checkpoint (saveState) and restore (loadState) of clsRasterData.
+ *        The restored raster must keep the compacted layout, positions, and
+ *        cached statistics without re-masking or recalculation.
+ *
+ * @version 1.0
+ * @revised 10/18/2026 Initial version.
+ *
+ */
+#include "gtest/gtest.h"
+#include "utilities.h"
+#include "clsRasterData.h"
+
+namespace {
+string apppath = GetAppPath();
+string resultpath = apppath + "../data/result" + SEP;
+
+TEST(clsRasterDataTestState, SingleLayerOwnPositions) {
+    clsRasterData<float> *rs = clsRasterData<float>::Init(apppath + "../data/dem_2.asc");
+    ASSERT_NE(nullptr, rs);
+    rs->setValue(2, 4, 100.f);
+    EXPECT_FLOAT_EQ(100.f, rs->getMaximum());  // statistics are cached before saving
+    string statefile = resultpath + "dem_2_state.bin";
+    EXPECT_TRUE(rs->saveState(statefile));
+
+    clsRasterData<float> *restored = new clsRasterData<float>();
+    EXPECT_FALSE(restored->loadState(apppath + "../data/dem_2.asc"));  // not a state file
+    clsRasterData<int> *wrongtype = new clsRasterData<int>();
+    EXPECT_FALSE(wrongtype->loadState(statefile));  // inconsistent data type
+    delete wrongtype;
+    // truncated or corrupted file is rejected before allocating the raster data
+    ifstream statefs(statefile.c_str(), ios::in | ios::binary);
+    string statebytes((istreambuf_iterator<char>(statefs)), istreambuf_iterator<char>());
+    statefs.close();
+    // the data type is tagged by RasterDataType and its size, which are the same among compilers
+    int typesize[2] = {0, 0};
+    ASSERT_GT(statebytes.size(), 8 + sizeof(int) + sizeof(typesize));
+    memcpy(typesize, statebytes.c_str() + 8 + sizeof(int), sizeof(typesize));
+    EXPECT_EQ((int) RDT_Float, typesize[0]);
+    EXPECT_EQ(4, typesize[1]);
+    string truncatedfile = resultpath + "dem_2_state_truncated.bin";
+    ofstream truncatedfs(truncatedfile.c_str(), ios::out | ios::binary | ios::trunc);
+    truncatedfs.write(statebytes.c_str(), statebytes.size() / 2);
+    truncatedfs.close();
+    EXPECT_FALSE(restored->loadState(truncatedfile));
+    int cellslyrs[2] = {rs->getCellNumber(), 1};
+    size_t cellspos = statebytes.find(string((const char *) cellslyrs, sizeof(cellslyrs)));
+    ASSERT_NE(string::npos, cellspos);
+    string corrupted(statebytes);
+    cellslyrs[0] = 0x7FFFFFFF;
+    corrupted.replace(cellspos, sizeof(int), (const char *) cellslyrs, sizeof(int));
+    string corruptedfile = resultpath + "dem_2_state_corrupted.bin";
+    ofstream corruptedfs(corruptedfile.c_str(), ios::out | ios::binary | ios::trunc);
+    corruptedfs.write(corrupted.c_str(), corrupted.size());
+    corruptedfs.close();
+    EXPECT_FALSE(restored->loadState(corruptedfile));
+    ASSERT_TRUE(restored->loadState(statefile));
+    EXPECT_EQ(rs->getCellNumber(), restored->getCellNumber());
+    EXPECT_EQ(rs->getRows(), restored->getRows());
+    EXPECT_EQ(rs->getCols(), restored->getCols());
+    EXPECT_EQ(rs->getCoreName(), restored->getCoreName());
+    EXPECT_FALSE(restored->is2DRaster());
+    EXPECT_TRUE(restored->PositionsCalculated());
+    EXPECT_TRUE(restored->PositionsAllocated());
+    EXPECT_TRUE(restored->StatisticsCalculated());
+    EXPECT_FLOAT_EQ(rs->getAverage(), restored->getAverage());
+    EXPECT_FLOAT_EQ(100.f, restored->getMaximum());
+    EXPECT_FLOAT_EQ(100.f, restored->getValue(2, 4));
+    for (int i = 0; i < rs->getCellNumber(); i++) {
+        EXPECT_EQ(rs->getRasterPositionDataPointer()[i][0], restored->getRasterPositionDataPointer()[i][0]);
+        EXPECT_EQ(rs->getRasterPositionDataPointer()[i][1], restored->getRasterPositionDataPointer()[i][1]);
+        EXPECT_FLOAT_EQ(rs->getRasterDataPointer()[i], restored->getRasterDataPointer()[i]);
+    }
+    delete restored;
+    delete rs;
+}
+
+TEST(clsRasterDataTestState, MultiLayersBorrowedPositions) {
+    clsRasterData<int> *maskrs = clsRasterData<int>::Init(apppath + "../data/mask1.asc", true);
+    ASSERT_NE(nullptr, maskrs);
+    vector<string> filenames;
+    filenames.emplace_back(apppath + "../data/dem_1.asc");
+    filenames.emplace_back(apppath + "../data/dem_2.asc");
+    filenames.emplace_back(apppath + "../data/dem_3.asc");
+    clsRasterData<float, int> *rs = clsRasterData<float, int>::Init(filenames, true, maskrs, true);
+    ASSERT_NE(nullptr, rs);
+    EXPECT_FALSE(rs->PositionsAllocated());
+    rs->calculateStatistics();
+    string statefile = resultpath + "dem_multi_state.bin";
+    EXPECT_TRUE(rs->saveState(statefile));
+
+    /// positions are borrowed from the consistent mask again
+    clsRasterData<float, int> *restored = new clsRasterData<float, int>();
+    ASSERT_TRUE(restored->loadState(statefile, maskrs));
+    EXPECT_TRUE(restored->is2DRaster());
+    EXPECT_EQ(rs->getLayers(), restored->getLayers());
+    EXPECT_FALSE(restored->PositionsAllocated());
+    EXPECT_EQ(maskrs->getRasterPositionDataPointer(), restored->getRasterPositionDataPointer());
+    EXPECT_EQ(maskrs, restored->getMask());
+    EXPECT_TRUE(restored->StatisticsCalculated());
+    for (int lyr = 1; lyr <= rs->getLayers(); lyr++) {
+        EXPECT_FLOAT_EQ(rs->getAverage(lyr), restored->getAverage(lyr));
+        EXPECT_FLOAT_EQ(rs->getValidNumber(lyr), restored->getValidNumber(lyr));
+        EXPECT_FLOAT_EQ(rs->getValue(3, 4, lyr), restored->getValue(3, 4, lyr));
+    }
+    delete restored;
+
+    /// without the mask, the positions are restored as owned data
+    restored = new clsRasterData<float, int>();
+    ASSERT_TRUE(restored->loadState(statefile));
+    EXPECT_TRUE(restored->PositionsAllocated());
+    EXPECT_NE(maskrs->getRasterPositionDataPointer(), restored->getRasterPositionDataPointer());
+    EXPECT_FLOAT_EQ(rs->getValue(3, 4, 2), restored->getValue(3, 4, 2));
+    delete restored;
+    delete rs;
+    delete maskrs;
+}
+} /* namespace */